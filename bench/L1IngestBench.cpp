@@ -0,0 +1,186 @@
+// Times Map layer 1 ingest through GameDataL1Parser::parse, the path Game::update uses every tick.
+//
+// A grid map of side x side points is generated with a town per player and markets and storages
+// spread over it. A local game_world plays it and serves the L1 of every tick; stopped trains turn
+// around, so every tick moves every train. Only the parse is timed, json::parse of the same payload
+// into a DOM is timed alongside for reference.
+//
+//   L1IngestBench [side] [players] [trains_per_player] [ticks]
+#define COUNT_ALLOCATIONS
+
+#include <src/utils/alloc_stats.h>
+#include <src/utils/histogram.h>
+#include <src/game/data/l1_parser.h>
+#include <tests/l1_fixture.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+
+static server_map generate_map(uint32_t side, uint32_t num_towns)
+{
+	json layer0;
+	layer0["idx"] = 1;
+	layer0["name"] = "generated";
+	layer0["points"] = json::array();
+	layer0["lines"] = json::array();
+
+	json layer1;
+	layer1["idx"] = 1;
+	layer1["posts"] = json::array();
+	layer1["trains"] = json::array();
+	layer1["ratings"] = json::object();
+
+	const uint32_t num_points = side * side;
+	const uint32_t town_step = std::max<uint32_t>(num_points / std::max<uint32_t>(num_towns, 1), 1);
+
+	uint32_t num_posts = 0;
+	uint32_t num_lines = 0;
+	uint32_t towns_left = num_towns;
+
+	for (uint32_t point_idx = 1; point_idx <= num_points; point_idx++)
+	{
+		const uint32_t x = (point_idx - 1) % side;
+		const uint32_t y = (point_idx - 1) / side;
+
+		json post;
+		post["point_idx"] = point_idx;
+		post["events"] = json::array();
+
+		if ((point_idx - 1) % town_step == 0 && towns_left > 0)
+		{
+			towns_left--;
+			post["type"] = Posts::TOWN;
+			post["name"] = "town-" + std::to_string(point_idx);
+			post["armor"] = 100;
+			post["level"] = 1;
+			post["player_idx"] = nullptr;
+			post["population"] = 3;
+			post["product"] = 300;
+			post["train_cooldown"] = 0;
+		}
+		else if (point_idx % 7 == 3)
+		{
+			post["type"] = Posts::MARKET;
+			post["name"] = "market-" + std::to_string(point_idx);
+			post["product"] = 200;
+			post["product_capacity"] = 200;
+			post["replenishment"] = 5;
+		}
+		else if (point_idx % 11 == 5)
+		{
+			post["type"] = Posts::STORAGE;
+			post["name"] = "storage-" + std::to_string(point_idx);
+			post["armor"] = 50;
+			post["armor_capacity"] = 100;
+			post["replenishment"] = 2;
+		}
+
+		json point;
+		point["idx"] = point_idx;
+
+		if (post.contains("type"))
+		{
+			post["idx"] = ++num_posts;
+			point["post_idx"] = num_posts;
+			layer1["posts"].push_back(post);
+		}
+		else
+		{
+			point["post_idx"] = nullptr;
+		}
+
+		layer0["points"].push_back(point);
+
+		// Lines to the right and down
+		if (x + 1 < side) layer0["lines"].push_back({ {"idx", ++num_lines}, {"length", 1 + point_idx % 4}, {"points", { point_idx, point_idx + 1 }} });
+		if (y + 1 < side) layer0["lines"].push_back({ {"idx", ++num_lines}, {"length", 1 + point_idx % 3}, {"points", { point_idx, point_idx + side }} });
+	}
+
+	server_map val;
+	val.name = "generated";
+	val.layer0 = layer0.dump();
+	val.layer1 = layer1.dump();
+	return val;
+}
+
+static void print_row(const std::string& name, const latency_histogram& hist, double payload_bytes)
+{
+	std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+		<< " mean " << std::setw(9) << hist.mean() / 1000.0 << " us"
+		<< "  p50 " << std::setw(9) << hist.percentile(50) / 1000.0 << " us"
+		<< "  p99 " << std::setw(9) << hist.percentile(99) / 1000.0 << " us"
+		<< "  max " << std::setw(9) << hist.max() / 1000.0 << " us"
+		<< "  " << std::setw(7) << payload_bytes / hist.mean() * 1000.0 << " MB/s" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	const uint32_t side = argc > 1 ? std::stoul(argv[1]) : 40;
+	const uint32_t num_players = argc > 2 ? std::stoul(argv[2]) : 32;
+	const uint32_t trains_per_player = argc > 3 ? std::stoul(argv[3]) : 8;
+	const uint32_t ticks = argc > 4 ? std::stoul(argv[4]) : 200;
+
+	try
+	{
+		if (num_players == 0 || num_players > 255) throw std::invalid_argument("players must be in 1..255");
+
+		const server_map map = generate_map(side, num_players);
+
+		game_world_config config;
+		config.trains_per_player = trains_per_player;
+
+		l1_fixture fixture("bench", map, (uint8_t)num_players, config);
+
+		std::cout << "L1IngestBench: " << side * side << " points, " << fixture.gamedata.posts.size() << " posts, "
+			<< fixture.gamedata.trains.ids.size() << " trains, " << num_players << " players, " << ticks << " ticks" << std::endl;
+
+		GameDataL1Parser parser;
+
+		latency_histogram parse_ns;
+		latency_histogram dom_ns;
+		uint64_t payload_bytes = 0;
+		uint64_t allocations = 0;
+
+		// The first tick grows the parser buffers and is not counted
+		for (uint32_t tick = 0; tick <= ticks; tick++)
+		{
+			const std::string& response = fixture.next_tick();
+
+			const uint64_t allocations_before = alloc_stats::allocations();
+			const auto start = std::chrono::steady_clock::now();
+
+			parser.parse(fixture.gamedata, response);
+
+			const auto parsed = std::chrono::steady_clock::now();
+			const uint64_t allocations_after = alloc_stats::allocations();
+
+			const json dom = json::parse(response);
+
+			const auto dom_parsed = std::chrono::steady_clock::now();
+
+			if (tick == 0) continue;
+
+			parse_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(parsed - start).count());
+			dom_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(dom_parsed - parsed).count());
+			payload_bytes += response.size();
+			allocations += allocations_after - allocations_before;
+		}
+
+		const double mean_bytes = (double)payload_bytes / ticks;
+
+		std::cout << "L1IngestBench: " << std::fixed << std::setprecision(0) << mean_bytes << " bytes per L1, "
+			<< std::setprecision(2) << (double)allocations / ticks << " allocations per parse" << std::endl;
+
+		print_row("L1 parser", parse_ns, mean_bytes);
+		print_row("json DOM", dom_ns, mean_bytes);
+	}
+	catch (const std::exception& err)
+	{
+		std::cout << "L1IngestBench: Error! " << err.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
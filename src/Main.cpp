@@ -1,10 +1,84 @@
 #include <src/lobby.h>
+#include <src/sessions.h>
+#include <src/utils/network/replay_connector.h>
+
+#include <chrono>
 
 const std::string DEFAULT_ADDR = "wgforge-srv.wargaming.net";
 const std::string DEFAULT_PORT = "443";
 
-int main()
+// Plays a captured session through the client pipeline at full speed
+int replay(const std::string& path, size_t repeat)
+{
+	boost::asio::io_service io;
+
+	network_stats stats;
+
+	for (size_t run = 0; run < repeat; run++)
+	{
+		replay_connector connector(io, path);
+		connector.stats = &stats;
+
+		Game game(connector);
+		game.drawer_mode = render_mode::HEADLESS;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		try
+		{
+			game.start({ "replay" });
+		}
+		catch (server_connector::Result err)
+		{
+			if (err == replay_connector::END_OF_CAPTURE) LOG_1("replay: End of the capture");
+			else LOG_1("replay: Session ended with code " << err);
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		LOG("Replay " << run + 1 << "/" << repeat << ": " << elapsed.count() << " us, " << connector.diverged() << " diverged request(s)");
+	}
+
+	stats.dump(std::cout);
+
+	return 0;
+}
+
+// Usage:
+//   Main                              interactive lobby
+//   Main <sessions_config>            every configured session headless
+//   Main replay <capture> [repeat]    replay a captured session without network
+int main(int argc, char* argv[])
 {
+	if (argc > 2 && std::string(argv[1]) == "replay")
+	{
+		try
+		{
+			return replay(argv[2], argc > 3 ? std::stoul(argv[3]) : 1);
+		}
+		catch (const std::exception& err)
+		{
+			LOG("Error! " << err.what());
+			return 1;
+		}
+	}
+
+	if (argc > 1)
+	{
+		try
+		{
+			Sessions sessions(SessionsConfig::load(argv[1]));
+			sessions.run();
+		}
+		catch (const std::exception& err)
+		{
+			LOG("Error! " << err.what());
+			return 1;
+		}
+
+		return 0;
+	}
+
 	boost::asio::io_service io;
 
 	Lobby lobby(io);
@@ -0,0 +1,56 @@
+#include <src/server/game_server.h>
+
+#include <thread>
+#include <vector>
+
+const unsigned short DEFAULT_SERVER_PORT = 2000;
+
+// Usage: ServerMain [port] [threads] [maps_dir] [default_map] [turn_timeout_ms]
+int main(int argc, char* argv[])
+{
+	unsigned short port = DEFAULT_SERVER_PORT;
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+
+	game_server_config config;
+
+	if (argc > 1) port = std::stoi(argv[1]);
+	if (argc > 2) threads = std::stoi(argv[2]);
+	if (argc > 3) config.maps_dir = argv[3];
+	if (argc > 4) config.default_map = argv[4];
+	if (argc > 5) config.world.turn_timeout_ms = std::stoi(argv[5]);
+
+	try
+	{
+		boost::asio::io_service io;
+
+		game_server server(io, port, config);
+		server.start();
+
+		boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+		signals.async_wait([&](const boost::system::error_code& ec, int signal) {
+			LOG("game_server: Stopping...");
+			server.stop();
+			io.stop();
+			});
+
+		std::vector<std::thread> pool;
+		for (unsigned int i = 1; i < threads; i++)
+		{
+			pool.emplace_back([&io]() { io.run(); });
+		}
+
+		io.run();
+
+		for (std::thread& thread : pool)
+		{
+			thread.join();
+		}
+	}
+	catch (const std::exception& err)
+	{
+		LOG("Error! " << err.what());
+		return 1;
+	}
+
+	return 0;
+}
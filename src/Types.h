@@ -12,6 +12,8 @@ namespace Types
 	using edge_idx_t = uint32_t;
 
 	using player_uid_t = std::string;
+	// Dense id a player_uid_t is interned to, see Players
+	using player_id_t = uint8_t;
 	using train_idx_t = uint32_t;
 	using post_idx_t = uint32_t;
 	using edge_length_t = uint32_t;
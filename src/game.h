@@ -1,9 +1,19 @@
 #pragma once
 
 
+#include <optional>
+
 #include <src/utils/network/server_connector.h>
 #include <src/render/game_drawer.h>
+#include <src/render/frame_capture.h>
 #include <src/game/solver.h>
+#include <src/game/speculator.h>
+#include <src/game/map_cache.h>
+#include <src/game/snapshot.h>
+#include <src/game/data/l1_parser.h>
+
+#include <src/utils/thread_pool.h>
+#include <src/utils/triple_buffer.h>
 
 #include <src/utils/MinMax.h>
 
@@ -13,7 +23,17 @@ class Game
 protected:
 
 	boost::thread* drawer_thread = nullptr;
-	status drawer_status = status::READY;
+	std::atomic<status> drawer_status{ status::READY };
+
+	// Copies of gamedata handed to the render thread, which never reads the live state
+	triple_buffer<GameData> drawer_snapshots;
+
+	// What the solver intends, published after every calculation for the routes layer
+	triple_buffer<PlanView> drawer_plans;
+
+	// Wakes the render thread on new snapshots and states, it sleeps otherwise
+	render_scheduler drawer_wakeup;
+	std::promise<sf::RenderWindow*> drawer_window_ready;
 
 	server_connector& connector;
 
@@ -23,11 +43,47 @@ public:
 
 	sf::RenderWindow* drawer_window = nullptr;
 	game_drawer_config drawer_config;
+	render_mode drawer_mode = render_mode::WINDOW;
+
+	// Every frames_interval-th tick is written to <frames_dir> in render_mode::CAPTURE
+	std::string frames_dir;
+	uint32_t frames_interval = 1;
+	std::unique_ptr<frame_capture> frames;
+
+	// Ticks ahead the routes layer predicts edge occupancy for
+	uint32_t plan_horizon = 10;
+
+	// Timings of the loop and the solver, shown by the HUD of the window
+	metrics_registry metrics;
+
+	// Overlap the solver with the Turn round trip, see GameSpeculator
+	bool speculative = false;
+
+	// Reused every tick, keeps its scratch buffers between updates
+	GameDataL1Parser l1_parser;
+
+	// Published after every L1 update, subscribers only look at what changed
+	Changes::ChangeStream changes;
+	Changes::ChangeCounters change_counters;
+
+	// Written in the background after every update when set, see game_snapshot
+	std::string snapshot_path;
+	game_snapshot_writer snapshot_writer;
+
+	// Resume from the snapshot at snapshot_path, e.g. after a crash: the map, the first L1 and the
+	// solver state come from the file, only the Login of the new connection goes to the server.
+	// Cleared when there is no snapshot yet.
+	bool restore_snapshot = false;
+	std::optional<GameSolver::Checkpoint> restored_checkpoint;
+
+	// Optional facilities shared between sessions running in one process
+	map_cache* maps = nullptr;
+	thread_pool* solver_pool = nullptr;
 
 	Game(server_connector& connector)
 		: connector(connector)
 	{
-
+		changes.subscribe([this](const Changes::ChangeList& val) { change_counters.consume(val); });
 	}
 
 	~Game()
@@ -40,26 +96,17 @@ public:
 		connector.connect(addr, port);
 	}
 
-	void init(const server_connector::Login& lobby)
+	// Map layers 0 and 10 and the first L1
+	void download_map()
 	{
-		this->drawer_set_state(status::UPDATING);
-
-		{
-			LOG_2("Game::init: Sending Login request...");
-			connector.send_Login(lobby);
-
-			const auto response = connector.read_packet();
-
-			GameData::readJSON_Login(gamedata, json::parse(response.second));
-		}
-
 		{
 			LOG_2("Game::init: Sending L0 request...");
 			connector.send_Map({ 0 });
 
 			const auto response = connector.read_packet();
 
-			GameData::readJSON_L0(gamedata, json::parse(response.second));
+			if (maps != nullptr) maps->readJSON_L0(gamedata, response.second);
+			else GameData::readJSON_L0(gamedata, json::parse(response.second));
 		}
 
 		{
@@ -68,7 +115,8 @@ public:
 
 			const auto response = connector.read_packet();
 
-			GameData::readJSON_L10(gamedata, json::parse(response.second));
+			if (maps != nullptr) maps->readJSON_L10(gamedata, response.second);
+			else GameData::readJSON_L10(gamedata, json::parse(response.second));
 		}
 
 		{
@@ -78,6 +126,61 @@ public:
 			const auto response = connector.read_packet();
 
 			GameData::readJSON_L1(gamedata, json::parse(response.second));
+			changes.publish(gamedata.changes);
+		}
+	}
+
+	// Replaces the map and the first L1 with the snapshot, the solvers start from its checkpoint.
+	// Without a snapshot yet the game starts over as usual.
+	void restore()
+	{
+		if (!std::filesystem::exists(snapshot_path))
+		{
+			LOG("Game::restore: No snapshot at " << snapshot_path << ", starting a new game");
+			restore_snapshot = false;
+			return;
+		}
+
+		LOG_2("Game::restore: Loading " << snapshot_path);
+
+		GameSolver::Checkpoint checkpoint;
+		try
+		{
+			game_snapshot::load(snapshot_path, gamedata, &checkpoint);
+		}
+		catch (const std::exception& err)
+		{
+			throw std::invalid_argument("Cannot restore " + snapshot_path + ": " + err.what());
+		}
+		restored_checkpoint = std::move(checkpoint);
+
+		changes.publish(gamedata.changes);
+	}
+
+	void init(const server_connector::Login& lobby)
+	{
+		this->drawer_set_state(status::UPDATING);
+
+		if (restore_snapshot) this->restore();
+
+		{
+			LOG_2("Game::init: Sending Login request...");
+			connector.send_Login(lobby);
+
+			const auto response = connector.read_packet();
+			const json j = json::parse(response.second);
+
+			if (restore_snapshot && j.contains("idx") && j["idx"] != gamedata.player_idx)
+			{
+				throw std::invalid_argument("The snapshot belongs to another player: " + snapshot_path);
+			}
+
+			GameData::readJSON_Login(gamedata, j);
+		}
+
+		if (!restore_snapshot)
+		{
+			this->download_map();
 		}
 
 		{
@@ -94,6 +197,8 @@ public:
 			drawer_config.padding_width.set_input(minmax_x.min(), minmax_x.max());
 			drawer_config.padding_height.set_input(minmax_y.min(), minmax_y.max());
 		}
+
+		this->publish_snapshot();
 	}
 
 	void update()
@@ -105,16 +210,82 @@ public:
 
 			const auto response = connector.read_packet();
 
-			GameData::readJSON_L1(gamedata, json::parse(response.second));
+			{
+				const metrics_registry::scoped_timer timer(&metrics, metrics_registry::L1_PARSE);
+				l1_parser.parse(gamedata, response.second);
+			}
+			metrics.begin_turn();
+
+			changes.publish(gamedata.changes);
+
+			LOG_3("Game::update: Tick " << gamedata.changes.tick << ": " << gamedata.changes.size() << " changes");
+		}
+
+		this->publish_snapshot();
+	}
+
+	// Solver is a GameSolver or a GameSpeculator, its checkpoint must match the current tick
+	template <class Solver>
+	void save_snapshot(const Solver& solver)
+	{
+		if (snapshot_path.empty()) return;
+
+		const GameSolver::Checkpoint checkpoint = solver.checkpoint();
+		snapshot_writer.save(snapshot_path, gamedata, &checkpoint);
+	}
+
+	// Starts a solver from the restored checkpoint, once
+	template <class Solver>
+	void restore_solver(Solver& solver)
+	{
+		if (!restored_checkpoint) return;
+
+		if (!solver.restore(*restored_checkpoint))
+		{
+			LOG("Game::restore_solver: The checkpoint of " << snapshot_path << " does not fit the trains, starting over");
+		}
+		restored_checkpoint.reset();
+	}
+
+	// Publishes a copy of the current state to the render thread or the frame writer
+	void publish_snapshot()
+	{
+		switch (drawer_mode)
+		{
+			case render_mode::WINDOW:
+			{
+				GameData::copy_state(drawer_snapshots.write_buffer(), gamedata);
+				drawer_snapshots.publish();
+				drawer_wakeup.notify();
+			} break;
+			case render_mode::CAPTURE:
+			{
+				if (frames != nullptr) frames->capture(gamedata);
+			} break;
+			case render_mode::HEADLESS:
+			{
+			} break;
 		}
 	}
 
+	// Publishes the routes of the last calculation to the render thread
+	template <class Solver>
+	void publish_plan(Solver& solver)
+	{
+		if (drawer_mode != render_mode::WINDOW) return;
+
+		solver.describe_plan(drawer_plans.write_buffer(), plan_horizon);
+		drawer_plans.publish();
+		drawer_wakeup.notify();
+	}
+
 	void reset()
 	{
 		LOG_2("Game::reset");
 
 		connector.disconnect();
 		this->drawer_stop();
+		frames.reset();
 		gamedata.clear();
 	}
 
@@ -127,8 +298,8 @@ public:
 		}
 
 		LOG_2("Game::drawer_set_state: Setting state [" << (uint32_t)s << "]...");
-		drawer_status = s;
-		drawer_thread->interrupt();
+		drawer_status.store(s, std::memory_order_release);
+		drawer_wakeup.notify();
 	}
 
 	void drawer_start()
@@ -139,17 +310,36 @@ public:
 			return;
 		}
 
+		this->drawer_configure();
+		drawer_config.atlas = new texture_atlas(drawer_config.atlas_paths);
+		drawer_config.fonts = new FontManager(drawer_config.fonts_paths);
+
+		LOG_2("Game::drawer_start: Starting game_drawer thread...");
+		drawer_window_ready = std::promise<sf::RenderWindow*>();
+		drawer_thread = new boost::thread(&game_drawer_thread, boost::ref(drawer_snapshots), boost::ref(drawer_plans), boost::ref(drawer_config), boost::ref(drawer_status), boost::ref(drawer_wakeup), boost::ref(drawer_window_ready));
+	}
+
+	void drawer_configure()
+	{
 		drawer_config.window_videomode = sf::VideoMode({ 800, 800 });
 
 		drawer_config.padding_width.set_output(100, 700);
 		drawer_config.padding_height.set_output(100, 700);
 
-		drawer_config.edge_length_font = WORKING_DIRECTORY + "res/arial.ttf";
+		drawer_config.fonts_paths = "res/fonts.cfg";
+		drawer_config.metrics = &metrics;
+		drawer_config.atlas_paths = "res/Game/textures.cfg";
+	}
 
-		drawer_config.textures = new TextureManager("res/Game/textures.cfg");
+	// Starts writing frames in render_mode::CAPTURE, the writer loads its own atlas and fonts
+	void frames_start()
+	{
+		if (frames != nullptr) return;
 
-		LOG_2("Game::drawer_start: Starting game_drawer thread...");
-		drawer_thread = new boost::thread(&game_drawer_thread, boost::ref(gamedata), boost::ref(drawer_config), boost::ref(drawer_status), boost::ref(drawer_window));
+		this->drawer_configure();
+
+		LOG_2("Game::frames_start: Writing every " << frames_interval << " tick(s) to " << frames_dir << "...");
+		frames = std::make_unique<frame_capture>(frames_dir, frames_interval, drawer_config);
 	}
 
 	void drawer_stop()
@@ -165,14 +355,18 @@ public:
 		drawer_thread = nullptr;
 		drawer_window = nullptr;
 
-		delete drawer_config.textures;
-		drawer_config.textures = nullptr;
+		delete drawer_config.atlas;
+		drawer_config.atlas = nullptr;
+
+		delete drawer_config.fonts;
+		drawer_config.fonts = nullptr;
 	}
 
-	void drawer_window_wait() const
+	// Blocks until the render thread has created its window, once per drawer_start
+	void drawer_window_wait()
 	{
 		LOG_2("Game::drawer_window_wait: Waiting for drawer_window...");
-		while (drawer_window == nullptr);
+		drawer_window = drawer_window_ready.get_future().get();
 		LOG_2("Game::drawer_window_wait: drawer_window ready!");
 	}
 
@@ -196,17 +390,26 @@ public:
 		this->connector.read_packet();
 	}
 
-	void calculate_move()
+	void calculate_move(GameSolver& gamesolver)
 	{
-		throw "TODO";
+		this->drawer_set_state(status::CALCULATING);
 
-		//this->drawer_set_state(game_drawer::CALCULATING);
+		if (solver_pool != nullptr)
+		{
+			solver_pool->submit([&gamesolver]() { gamesolver.calculate(); }).get();
+		}
+		else
+		{
+			gamesolver.calculate();
+		}
 	}
 
 	void await_move()
 	{
 		this->drawer_set_state(status::READY);
 
+		this->connector.read_pending();
+
 		this->connector.send_Turn();
 		this->connector.read_packet();
 
@@ -218,32 +421,76 @@ public:
 		try
 		{
 
-			this->init(lobby);
+			metrics.network = connector.stats;
 
-			this->drawer_start();
-			this->drawer_window_wait();
+			this->init(lobby);
 
-			GameSolver gamesolver(gamedata, connector);
+			if (drawer_mode == render_mode::WINDOW)
+			{
+				this->drawer_start();
+				this->drawer_window_wait();
+			}
+			else if (drawer_mode == render_mode::CAPTURE)
+			{
+				this->frames_start();
+			}
 
-			this->await_run();
+			// A restored game is already running
+			if (!restore_snapshot) this->await_run();
 			this->update();
 
 			//this->drawer_set_state(status::READY);
 			//this->drawer_join();
 
+			if (speculative)
+			{
+				GameSpeculator speculator(gamedata, connector, solver_pool, &metrics);
+				this->restore_solver(speculator);
+
+				this->drawer_set_state(status::CALCULATING);
+				speculator.calculate();
+				this->publish_plan(speculator);
+
+				while (true)
+				{
+					speculator.speculate();
+
+					this->await_move();
+
+					this->update();
+
+					this->drawer_set_state(status::CALCULATING);
+					speculator.commit();
+					this->save_snapshot(speculator);
+					this->publish_plan(speculator);
+
+					LOG_2("Game::start: Speculation hits " << speculator.hits << ", misses " << speculator.misses);
+				}
+			}
+
+			GameSolver gamesolver(gamedata, connector);
+			gamesolver.metrics = &metrics;
+			this->restore_solver(gamesolver);
+
+			const Changes::ScopedSubscription solver_changes(changes, [&gamesolver](const Changes::ChangeList& val) {
+				gamesolver.apply_changes(val);
+				});
+
 			while (true)
 			{
-				//gamesolver.calculate();
+				this->calculate_move(gamesolver);
+				this->publish_plan(gamesolver);
 
 				this->await_move();
 
 				this->update();
+				this->save_snapshot(gamesolver);
 			}
 
 			LOG("The GAME has ended!");
 			LOG("Final Player info:");
 
-			for (const auto& [player_idx, player] : gamedata.players)
+			for (const Player& player : gamedata.players)
 			{
 				LOG(player.encodeJSON());
 			}
@@ -252,8 +499,11 @@ public:
 		catch (const std::invalid_argument& err)
 		{
 			LOG("Error! " << err.what());
-			this->drawer_window->setTitle((std::string)"Error! " + err.what());
-			this->drawer_join();
+			if (this->drawer_window != nullptr)
+			{
+				this->drawer_window->setTitle((std::string)"Error! " + err.what());
+				this->drawer_join();
+			}
 		}
 
 		connector.send_Logout();
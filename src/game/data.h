@@ -8,8 +8,10 @@
 #include <src/utils/ptr_container.h>
 
 #include <src/game/data/event.h>
-#include <src/game/data/train.h>
+#include <src/game/data/event_log.h>
+#include <src/game/data/changes.h>
 #include <src/game/data/player.h>
+#include <src/game/data/train.h>
 #include <src/game/data/post.h>
 
 #include <src/lobby/data.h>
@@ -24,51 +26,55 @@ struct GameData
 	GameState game_state;
 
 	Types::player_uid_t player_idx;
+	Types::player_id_t player_id = Players::NONE;
 	Types::vertex_idx_t home_idx;
 	Types::post_idx_t post_idx;
 	bool in_game;
 
-	std::map<Types::player_uid_t, Player> players;
-	std::map<Types::train_idx_t, Trains::Train*> trains;
+	Players players;
+	Trains::TrainTable trains;
 
-	GraphIdx map_graph;
-	CoordsHolder* map_graph_coords = nullptr;
+	// Read-only after loading, may be shared between sessions playing the same map
+	std::shared_ptr<const GraphIdx> map_graph;
+	std::shared_ptr<const CoordsHolder> map_graph_coords;
 	Types::position_t map_graph_width;
 	Types::position_t map_graph_height;
 
-	ptr_container::map<Types::post_idx_t, Posts::Post> posts;
+	Posts::PostTables posts;
 
-	Graph::Graph& graph()
-	{
-		return map_graph.graph;
-	}
+	// History of the events of posts and trains, also holds the current tick
+	Events::EventLog events;
+
+	// What the last L1 update changed, see GameDataL1Parser. Lists of the JSON readers are always full.
+	Changes::ChangeList changes;
 
 	const Graph::Graph& graph() const
 	{
-		return map_graph.graph;
+		return map_graph->graph;
 	}
 
 	Player& self_data()
 	{
-		return players.at(player_idx);
+		return players[player_id];
 	}
 
 	const Player& self_data() const
 	{
-		return players.at(player_idx);
+		return players[player_id];
 	}
 
 	void clear()
 	{
+		player_id = Players::NONE;
+
 		players.clear();
-		map_graph.clear();
+		trains.clear();
 		posts.clear();
+		events.clear();
+		changes.reset(true);
 
-		if (map_graph_coords != nullptr)
-		{
-			delete map_graph_coords;
-			map_graph_coords = nullptr;
-		}
+		map_graph.reset();
+		map_graph_coords.reset();
 	}
 
 	static void readJSON_Login(GameData& val, const json& j)
@@ -76,6 +82,7 @@ struct GameData
 		if (j.find("error") != j.end()) throw std::invalid_argument(j["error"].get<std::string>());
 
 		j["idx"].get_to(val.player_idx);
+		val.player_id = val.players.intern(val.player_idx);
 		j["home"]["idx"].get_to(val.home_idx);
 		j["home"]["post_idx"].get_to(val.post_idx);
 		j["in_game"].get_to(val.in_game);
@@ -83,14 +90,18 @@ struct GameData
 
 	static void readJSON_L0(GameData& val, const json& j)
 	{
-		GraphIdx::readJSON_L0(val.map_graph, j);
+		std::shared_ptr<GraphIdx> map_graph = std::make_shared<GraphIdx>();
+
+		GraphIdx::readJSON_L0(*map_graph, j);
+
+		val.map_graph = std::move(map_graph);
 	}
 
 	//-------------------- CLIENT-SIDE COORDINATES --------------------//
 
 	static void calculateCoordinates(GameData& val, double topology_width, double topology_height, double unit_edge_length)
 	{
-		val.map_graph_coords = (CoordsHolder*) new KKSCoordsCalculator(val.map_graph.graph, topology_width, topology_height, unit_edge_length);
+		val.map_graph_coords = std::make_shared<KKSCoordsCalculator>(val.map_graph->graph, topology_width, topology_height, unit_edge_length);
 
 		// Read Graph border size
 		val.map_graph_width = topology_width;
@@ -103,83 +114,113 @@ struct GameData
 	{
 		if (j.find("error") != j.end()) throw std::invalid_argument(j["error"].get<std::string>());
 
-		val.map_graph_coords = new CoordsHolder(val.map_graph.graph);
+		std::shared_ptr<CoordsHolder> map_graph_coords = std::make_shared<CoordsHolder>(val.map_graph->graph);
 
 		// Read Vertex coordinates
 		for (const json& ji : j["coordinates"])
 		{
 			Types::vertex_idx_t idx = ji["idx"].get<Types::vertex_idx_t>();
 
-			CoordsHolder::point_type& point = (*val.map_graph_coords)[val.map_graph.vmap.at(idx)];
+			CoordsHolder::point_type& point = (*map_graph_coords)[val.map_graph->vmap.at(idx)];
 
 			ji["x"].get_to(point[0]);
 			ji["y"].get_to(point[1]);
 		}
 
+		val.map_graph_coords = std::move(map_graph_coords);
+
 		// Read Graph border size
 		val.map_graph_width = j["size"][0].get<Types::position_t>();
 		val.map_graph_height = j["size"][1].get<Types::position_t>();
 	}
 
-	static void readJSON_L1(GameData& val, const json& j)
+	// Post and train as listed in Map layer 1, with the events logged on the current tick
+	json encodeJSON_Post(Types::post_idx_t post_idx) const
 	{
-		if (j.find("error") != j.end()) throw std::invalid_argument(j["error"].get<std::string>());
+		json j = posts.encodeJSON(post_idx, players);
+		j["events"] = events.encodeJSON(Events::Subject::POST, post_idx, events.tick());
+		return j;
+	}
 
-		//Parse Players
-		for (const auto& [player_idx, ji] : j["ratings"].items())
-		{
-			//Player memory initialization + value initialization
-			Player::readJSON_L1(val.players[player_idx], ji);
-		}
+	json encodeJSON_Train(Types::train_idx_t train_idx) const
+	{
+		json j = trains.encodeJSON(train_idx, players);
+		j["events"] = events.encodeJSON(Events::Subject::TRAIN, train_idx, events.tick());
+		return j;
+	}
 
-		//Parse Trains
-		for (const json& ji : j["trains"])
-		{
-			Types::train_idx_t train_idx = ji["idx"].get<Types::train_idx_t>();
-			Types::player_uid_t player_idx = ji["player_idx"].get<Types::player_uid_t>();
+	// Layers without a tick are taken as the next one
+	static void readJSON_Tick(GameData& val, const json& j)
+	{
+		const auto it = j.find("tick");
+		val.events.begin_tick(it != j.end() ? it->get<Types::tick_t>() : val.events.tick() + 1);
+	}
 
-			//Train memory initialization + value initialization
-			Trains::Train::readJSON_L1(val.players.at(player_idx).trains[train_idx], ji);
-			val.trains[train_idx] = &val.players.at(player_idx).trains.at(train_idx);
-		}
+	// Logs the events listed by a post or train of Map layer 1
+	static void readJSON_Events(GameData& val, Events::Subject subject, uint32_t subject_idx, const json& j)
+	{
+		const auto it = j.find("events");
+		if (it == j.end()) return;
 
-		//Parse Posts
-		for (const json& ji : j["posts"])
+		for (const json& ji : *it)
 		{
-			Types::post_idx_t post_idx = ji["idx"].get<Types::post_idx_t>();
-
-			val.posts[post_idx] = std::unique_ptr<Posts::Post>(Posts::make_Post(ji));
+			Events::Event event;
+			if (Events::Event::readJSON_L1(event, ji, val.events.tick())) val.events.add(subject, subject_idx, event);
 		}
 	}
 
-	static void updateJSON_L1(GameData& val, const json& j)
+	static void readJSON_L1(GameData& val, const json& j)
 	{
 		if (j.find("error") != j.end()) throw std::invalid_argument(j["error"].get<std::string>());
 
+		readJSON_Tick(val, j);
+		val.changes.reset(true);
+		val.changes.tick = val.events.tick();
+
 		//Parse Players
 		for (const auto& [player_idx, ji] : j["ratings"].items())
 		{
 			//Player memory initialization + value initialization
-			Player::updateJSON_L1(val.players[player_idx], ji);
+			Player::readJSON_L1(val.players[val.players.intern(player_idx)], ji);
 		}
 
 		//Parse Trains
 		for (const json& ji : j["trains"])
 		{
-			Types::train_idx_t train_idx = ji["idx"].get<Types::train_idx_t>();
-			Types::player_uid_t player_idx = ji["player_idx"].get<Types::player_uid_t>();
-
-			Trains::Train::updateJSON_L1(val.players.at(player_idx).trains[train_idx], ji);
+			Trains::TrainTable::readJSON_L1(val.trains, ji, val.players);
+			readJSON_Events(val, Events::Subject::TRAIN, ji["idx"].get<Types::train_idx_t>(), ji);
 		}
 
 		//Parse Posts
 		for (const json& ji : j["posts"])
 		{
-			Types::post_idx_t post_idx = ji["idx"].get<Types::post_idx_t>();
-
-			Posts::updateJSON_L1(val.posts.at(post_idx).get(), ji);
+			Posts::PostTables::readJSON_L1(val.posts, ji, val.players);
+			readJSON_Events(val, Events::Subject::POST, ji["idx"].get<Types::post_idx_t>(), ji);
 		}
 	}
 
+	// Copies the game state, sharing the read-only map.
+	// Tables are copy-assigned, which reuses the capacity the destination already has.
+	static void copy_state(GameData& dst, const GameData& src)
+	{
+		dst.game_state = src.game_state;
+		dst.player_idx = src.player_idx;
+		dst.player_id = src.player_id;
+		dst.home_idx = src.home_idx;
+		dst.post_idx = src.post_idx;
+		dst.in_game = src.in_game;
+
+		dst.map_graph = src.map_graph;
+		dst.map_graph_coords = src.map_graph_coords;
+		dst.map_graph_width = src.map_graph_width;
+		dst.map_graph_height = src.map_graph_height;
+
+		dst.players = src.players;
+		dst.trains = src.trains;
+		dst.posts = src.posts;
+		dst.events = src.events;
+		dst.changes = src.changes;
+	}
+
 	CLASS_VIRTUAL_DESTRUCTOR(GameData);
 };
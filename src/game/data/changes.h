@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include <src/game/data/event_log.h>
+
+
+namespace Changes {
+
+	enum ChangeType : uint8_t
+	{
+		TRAIN_ADDED,
+		// line_idx, position or speed
+		TRAIN_MOVED,
+		// goods or goods_type
+		TRAIN_CARGO,
+		TRAIN_LEVEL,
+		TRAIN_COOLDOWN,
+
+		POST_ADDED,
+		// armor, product, population, their capacities or replenishment
+		POST_STOCK,
+		POST_LEVEL,
+		POST_OWNER,
+		POST_COOLDOWN,
+
+		EVENT_ADDED,
+
+		// idx, name or rating
+		PLAYER_CHANGED,
+
+		NUM_TYPES
+	};
+
+	// What changed on one entity. idx is the train_idx, post_idx or player_id after the type;
+	// EVENT_ADDED also names the subject the event was logged for.
+	struct Change
+	{
+		ChangeType type;
+		Events::Subject subject;
+		uint32_t idx;
+	};
+
+	// Typed changes of one L1 update, at most one entry per type and entity.
+	//
+	// Each list gets the next seq, so a consumer that missed a list (or got a full one) knows
+	// it has to re-read the whole state instead of applying the deltas, see continues().
+	class ChangeList
+	{
+	public:
+
+		Types::tick_t tick = 0;
+		uint64_t seq = 0;
+
+		// Set when the state was read from scratch and everything is to be considered changed
+		bool full = true;
+
+		std::vector<Change> items;
+
+		// Starts the list of the next update, keeping the capacity
+		void reset(bool full)
+		{
+			seq++;
+			this->full = full;
+			items.clear();
+		}
+
+		void add(ChangeType type, uint32_t idx, Events::Subject subject = Events::Subject::POST)
+		{
+			items.push_back({ type, subject, idx });
+		}
+
+		// Adds one change for every type set in mask, see bit()
+		void add_mask(uint32_t mask, uint32_t idx)
+		{
+			for (uint8_t type = 0; mask != 0; type++, mask >>= 1)
+			{
+				if (mask & 1) add((ChangeType)type, idx);
+			}
+		}
+
+		static uint32_t bit(ChangeType type)
+		{
+			return uint32_t(1) << type;
+		}
+
+		// True if the list holds exactly the changes since the list with prev_seq
+		bool continues(uint64_t prev_seq) const
+		{
+			return !full && seq == prev_seq + 1;
+		}
+
+		size_t size() const
+		{
+			return items.size();
+		}
+
+		// Calls f(change) for every change of the type
+		template <class Func>
+		void for_each(ChangeType type, Func f) const
+		{
+			for (const Change& change : items)
+			{
+				if (change.type == type) f(change);
+			}
+		}
+	};
+
+	// Hands the change list of every update to the subscribers, on the thread that publishes it.
+	// Subscribers run in subscription order and must not subscribe or unsubscribe from the callback.
+	class ChangeStream
+	{
+	public:
+
+		using subscriber_t = std::function<void(const ChangeList&)>;
+		using subscription_t = size_t;
+
+		subscription_t subscribe(subscriber_t f)
+		{
+			subscribers.push_back({ next_id, std::move(f) });
+			return next_id++;
+		}
+
+		void unsubscribe(subscription_t id)
+		{
+			for (auto it = subscribers.begin(); it != subscribers.end(); ++it)
+			{
+				if (it->first == id)
+				{
+					subscribers.erase(it);
+					return;
+				}
+			}
+		}
+
+		void publish(const ChangeList& val) const
+		{
+			for (const auto& [id, f] : subscribers)
+			{
+				f(val);
+			}
+		}
+
+	protected:
+
+		std::vector<std::pair<subscription_t, subscriber_t>> subscribers;
+		subscription_t next_id = 0;
+	};
+
+	// Subscription that ends with its scope, for subscribers that do not outlive a block
+	class ScopedSubscription
+	{
+	public:
+
+		ScopedSubscription(ChangeStream& stream, ChangeStream::subscriber_t f)
+			: stream(stream), id(stream.subscribe(std::move(f))) {}
+
+		~ScopedSubscription()
+		{
+			stream.unsubscribe(id);
+		}
+
+		ScopedSubscription(const ScopedSubscription&) = delete;
+		ScopedSubscription& operator=(const ScopedSubscription&) = delete;
+
+	protected:
+
+		ChangeStream& stream;
+		const ChangeStream::subscription_t id;
+	};
+
+	// Running totals of the changes per type, readable from any thread
+	class ChangeCounters
+	{
+	public:
+
+		void consume(const ChangeList& val)
+		{
+			lists.fetch_add(1, std::memory_order_relaxed);
+			if (val.full) full_lists.fetch_add(1, std::memory_order_relaxed);
+
+			for (const Change& change : val.items)
+			{
+				counts[change.type].fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		uint64_t count(ChangeType type) const
+		{
+			return counts[type].load(std::memory_order_relaxed);
+		}
+
+		uint64_t num_lists() const
+		{
+			return lists.load(std::memory_order_relaxed);
+		}
+
+		uint64_t num_full_lists() const
+		{
+			return full_lists.load(std::memory_order_relaxed);
+		}
+
+	protected:
+
+		std::atomic<uint64_t> counts[NUM_TYPES] = {};
+		std::atomic<uint64_t> lists{ 0 };
+		std::atomic<uint64_t> full_lists{ 0 };
+	};
+
+} // namespace Changes
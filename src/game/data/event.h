@@ -1,7 +1,8 @@
 #pragma once
 
+#include <type_traits>
+
 #include <src/game/data/base_json_encodable.h>
-#include <boost/ptr_container/ptr_vector.hpp>
 
 
 namespace Events {
@@ -17,241 +18,112 @@ namespace Events {
 		GAME_OVER = 100
 	};
 
-	struct Event : public base_json_encodable
-	{
-		virtual EventType type() const = 0;
-	};
-
-	struct Event_TrainCrash : public Event
+	// Fixed-size record of any event, the payload member in use is picked by type.
+	// Trivially copyable, so a history of events is stored and copied as plain memory, see EventLog.
+	struct Event
 	{
-		Types::train_idx_t train;
-		Types::tick_t tick;
-
-		EventType type() const { return EventType::TRAIN_COLLISION; }
-
-		json encodeJSON() const
+		struct TrainCrash
 		{
-			json j;
-
-			j["type"] = EventType::TRAIN_COLLISION;
-			j["trains"] = train;
-			j["tick"] = tick;
-
-			return j;
-		}
+			Types::train_idx_t train;
+		};
 
-		[[nodiscard]]
-		static Event_TrainCrash* readJSON_L1(const json& j)
+		// PARASITES_ASSAULT and HIJACKERS_ASSAULT
+		struct Assault
 		{
-			Event_TrainCrash* event = new Event_TrainCrash;
+			uint8_t power;
+		};
 
-			j["trains"].get_to(event->train);
-			j["tick"].get_to(event->tick);
-
-			return event;
-		}
-
-		CLASS_VIRTUAL_DESTRUCTOR(Event_TrainCrash);
-	};
-
-	struct Event_Parasites : public Event
-	{
-		uint8_t parasite_power;
-		Types::tick_t tick;
-
-		EventType type() const { return EventType::PARASITES_ASSAULT; }
-
-		json encodeJSON() const
+		struct Refugees
 		{
-			json j;
+			uint8_t number;
+		};
 
-			j["type"] = EventType::PARASITES_ASSAULT;
-			j["parasites_power"] = parasite_power;
-			j["tick"] = tick;
+		EventType type;
 
-			return j;
-		}
-
-		[[nodiscard]]
-		static Event_Parasites* readJSON_L1(const json& j)
-		{
-			Event_Parasites* event = new Event_Parasites;
-
-			j["parasites_power"].get_to(event->parasite_power);
-			j["tick"].get_to(event->tick);
-
-			return event;
-		}
-
-		CLASS_VIRTUAL_DESTRUCTOR(Event_Parasites);
-	};
-
-	struct Event_Bandits : public Event
-	{
-		uint8_t hijacker_power;
+		// Events without a tick of their own get the tick they were logged on
 		Types::tick_t tick;
 
-		EventType type() const { return EventType::HIJACKERS_ASSAULT; }
-
-		json encodeJSON() const
+		union
 		{
-			json j;
-
-			j["type"] = EventType::HIJACKERS_ASSAULT;
-			j["hijackers_power"] = hijacker_power;
-			j["tick"] = tick;
-
-			return j;
-		}
-
-		[[nodiscard]]
-		static Event_Bandits* readJSON_L1(const json& j)
-		{
-			Event_Bandits* event = new Event_Bandits;
-
-			j["hijackers_power"].get_to(event->hijacker_power);
-			j["tick"].get_to(event->tick);
-
-			return event;
-		}
-
-		CLASS_VIRTUAL_DESTRUCTOR(Event_Bandits);
-	};
-
-	struct Event_Refugees : public Event
-	{
-		uint8_t refugees_number;
-		Types::tick_t tick;
-
-		EventType type() const { return EventType::REFUGEES_ARRIVAL; }
+			TrainCrash crash;
+			Assault assault;
+			Refugees refugees;
+		};
 
-		json encodeJSON() const
+		bool has_tick() const
 		{
-			json j;
-
-			j["type"] = EventType::REFUGEES_ARRIVAL;
-			j["refugees_number"] = refugees_number;
-			j["tick"] = tick;
-
-			return j;
+			switch (type)
+			{
+			case EventType::TRAIN_COLLISION:
+			case EventType::PARASITES_ASSAULT:
+			case EventType::HIJACKERS_ASSAULT:
+			case EventType::REFUGEES_ARRIVAL:	return true;
+			default:							return false;
+			}
 		}
 
-
-
-		[[nodiscard]]
-		static Event_Refugees* readJSON_L1(const json& j)
+		bool operator==(const Event& other) const
 		{
-			Event_Refugees* event = new Event_Refugees;
-
-			j["refugees_number"].get_to(event->refugees_number);
-			j["tick"].get_to(event->tick);
+			if (type != other.type || tick != other.tick) return false;
 
-			return event;
+			switch (type)
+			{
+			case EventType::TRAIN_COLLISION:	return crash.train == other.crash.train;
+			case EventType::PARASITES_ASSAULT:
+			case EventType::HIJACKERS_ASSAULT:	return assault.power == other.assault.power;
+			case EventType::REFUGEES_ARRIVAL:	return refugees.number == other.refugees.number;
+			default:							return true;
+			}
 		}
 
-		CLASS_VIRTUAL_DESTRUCTOR(Event_Refugees);
-	};
-
-	struct Event_ResourceOverflow : public Event
-	{
-		EventType type() const { return EventType::RESOURCE_OVERFLOW; }
+		bool operator!=(const Event& other) const { return !(*this == other); }
 
 		json encodeJSON() const
 		{
 			json j;
 
-			j["type"] = EventType::RESOURCE_OVERFLOW;
+			j["type"] = type;
 
-			return j;
-		}
-
-		[[nodiscard]]
-		static Event_ResourceOverflow* readJSON_L1(const json& j)
-		{
-			Event_ResourceOverflow* event = new Event_ResourceOverflow;
+			switch (type)
+			{
+			case EventType::TRAIN_COLLISION:	j["trains"] = crash.train; break;
+			case EventType::PARASITES_ASSAULT:	j["parasites_power"] = assault.power; break;
+			case EventType::HIJACKERS_ASSAULT:	j["hijackers_power"] = assault.power; break;
+			case EventType::REFUGEES_ARRIVAL:	j["refugees_number"] = refugees.number; break;
+			default:							break;
+			}
 
-			return event;
-		}
-
-		CLASS_VIRTUAL_DESTRUCTOR(Event_ResourceOverflow);
-	};
-
-	struct Event_ResourceLack : public Event
-	{
-		EventType type() const { return EventType::RESOURCE_LACK; }
-
-		json encodeJSON() const
-		{
-			json j;
-
-			j["type"] = EventType::RESOURCE_LACK;
+			if (has_tick()) j["tick"] = tick;
 
 			return j;
 		}
 
-		[[nodiscard]]
-		static Event_ResourceLack* readJSON_L1(const json& j)
+		// False for an unknown type. Events without a tick get the given one.
+		static bool readJSON_L1(Event& val, const json& j, Types::tick_t tick)
 		{
-			Event_ResourceLack* event = new Event_ResourceLack;
+			val = Event{};
+			val.type = (EventType)j["type"].get<int>();
+			val.tick = tick;
 
-			return event;
-		}
+			LOG("Event! " << j);
 
-		CLASS_VIRTUAL_DESTRUCTOR(Event_ResourceLack);
-	};
+			switch (val.type)
+			{
+			case EventType::TRAIN_COLLISION:	j["trains"].get_to(val.crash.train); break;
+			case EventType::PARASITES_ASSAULT:	j["parasites_power"].get_to(val.assault.power); break;
+			case EventType::HIJACKERS_ASSAULT:	j["hijackers_power"].get_to(val.assault.power); break;
+			case EventType::REFUGEES_ARRIVAL:	j["refugees_number"].get_to(val.refugees.number); break;
+			case EventType::RESOURCE_OVERFLOW:
+			case EventType::RESOURCE_LACK:
+			case EventType::GAME_OVER:			return true;
+			default:							return false;
+			}
 
-	struct Event_GameOver : public Event
-	{
-		EventType type() const { return EventType::GAME_OVER; }
-
-		json encodeJSON() const
-		{
-			json j;
-
-			j["type"] = EventType::GAME_OVER;
-
-			return j;
+			j["tick"].get_to(val.tick);
+			return true;
 		}
-
-		[[nodiscard]]
-		static Event_GameOver* readJSON_L1(const json& j)
-		{
-			Event_GameOver* event = new Event_GameOver;
-
-			return event;
-		}
-
-		CLASS_VIRTUAL_DESTRUCTOR(Event_GameOver);
 	};
 
-	[[nodiscard]]
-	inline Event* make_Event(const json& j)
-	{
-		EventType event_type = (EventType)j["type"].get<int>();
-
-		LOG("Event! " << j);
-
-		switch (event_type)
-		{
-		case EventType::TRAIN_COLLISION:	return dynamic_cast<Event*>(Event_TrainCrash::readJSON_L1(j));
-		case EventType::PARASITES_ASSAULT:	return dynamic_cast<Event*>(Event_Parasites::readJSON_L1(j));
-		case EventType::HIJACKERS_ASSAULT:	return dynamic_cast<Event*>(Event_Bandits::readJSON_L1(j));
-		case EventType::REFUGEES_ARRIVAL:	return dynamic_cast<Event*>(Event_Refugees::readJSON_L1(j));
-		case EventType::RESOURCE_OVERFLOW:	return dynamic_cast<Event*>(Event_ResourceOverflow::readJSON_L1(j));
-		case EventType::RESOURCE_LACK:		return dynamic_cast<Event*>(Event_ResourceLack::readJSON_L1(j));
-		case EventType::GAME_OVER:			return dynamic_cast<Event*>(Event_GameOver::readJSON_L1(j));
-		default:							return nullptr;
-		}
-	}
-
-	inline void make_Event_vector(boost::ptr_vector<Event>& vec, const json& j)
-	{
-		vec.clear();
-		vec.reserve(j["events"].size());
-		for (const json& ji : j["events"])
-		{
-			vec.push_back(make_Event(ji));
-		}
-	}
+	static_assert(std::is_trivially_copyable_v<Event>, "Events are stored as plain memory");
 
 } // namespace Events
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <src/game/data/event.h>
+
+
+namespace Events {
+
+	// What an event happened to
+	enum class Subject : uint8_t
+	{
+		POST,
+		TRAIN
+	};
+
+	// Bounded history of the events of every post and train.
+	//
+	// Entries are kept in a ring in the order they were logged, so their ticks never decrease along
+	// the ring and a tick range is found by bisection. Each entry also links to the previous entry of
+	// the same post or train, so per-subject queries only visit that subject's events. Once the ring
+	// is full the oldest entries are overwritten. Nothing is allocated after the subjects are first
+	// tracked, and copying a log into one of the same capacity is a plain memory copy.
+	class EventLog
+	{
+	public:
+
+		static constexpr uint64_t NPOS = UINT64_MAX;
+
+		struct Entry
+		{
+			Event event;
+			Types::tick_t logged;
+			Subject subject;
+			uint32_t subject_idx;
+
+			// Sequence number of the previous entry of the same subject, NPOS for the first one
+			uint64_t prev;
+		};
+
+		explicit EventLog(size_t capacity = 4096)
+			: ring(capacity) {}
+
+		size_t capacity() const
+		{
+			return ring.size();
+		}
+
+		// Retained entries
+		size_t size() const
+		{
+			return (size_t)(next - oldest());
+		}
+
+		// Tick the events are currently logged on
+		Types::tick_t tick() const
+		{
+			return current;
+		}
+
+		void clear()
+		{
+			next = 0;
+			current = 0;
+			post_heads.clear();
+			train_heads.clear();
+		}
+
+		// Starts logging the events of a tick. Going back in time means a new game, the history is dropped.
+		void begin_tick(Types::tick_t tick)
+		{
+			if (tick < current) clear();
+			current = tick;
+		}
+
+		// Makes room for the events of a new post or train, so logging them later does not allocate
+		void track(Subject subject, uint32_t subject_idx)
+		{
+			std::vector<uint64_t>& heads = subject_heads(subject);
+			if (subject_idx >= heads.size()) heads.resize(subject_idx + 1, NPOS);
+		}
+
+		// Logs the event on the current tick. Servers may list an event again in later layers,
+		// so an event the subject already has is skipped; returns false in that case.
+		bool add(Subject subject, uint32_t subject_idx, const Event& event)
+		{
+			track(subject, subject_idx);
+			std::vector<uint64_t>& heads = subject_heads(subject);
+
+			// An event is never logged before its own tick, older entries can not repeat it
+			for (uint64_t seq = heads[subject_idx]; retained(seq) && entry(seq).logged >= event.tick; seq = entry(seq).prev)
+			{
+				if (entry(seq).event == event) return false;
+			}
+
+			ring[next % ring.size()] = Entry{ event, current, subject, subject_idx, heads[subject_idx] };
+			heads[subject_idx] = next++;
+			return true;
+		}
+
+		//------------------------------ QUERIES ------------------------------//
+
+		// Calls f(entry) for every retained event logged on or after the tick, oldest first
+		template <class Func>
+		void for_each_since(Types::tick_t since, Func f) const
+		{
+			uint64_t lo = oldest();
+			uint64_t hi = next;
+
+			while (lo < hi)
+			{
+				const uint64_t mid = lo + (hi - lo) / 2;
+				if (entry(mid).logged < since) lo = mid + 1;
+				else hi = mid;
+			}
+
+			for (; lo < next; lo++) f(entry(lo));
+		}
+
+		// Calls f(entry) for every retained event of the subject logged on or after the tick, newest first
+		template <class Func>
+		void for_each_of(Subject subject, uint32_t subject_idx, Types::tick_t since, Func f) const
+		{
+			const std::vector<uint64_t>& heads = subject_heads(subject);
+			if (subject_idx >= heads.size()) return;
+
+			for (uint64_t seq = heads[subject_idx]; retained(seq) && entry(seq).logged >= since; seq = entry(seq).prev)
+			{
+				f(entry(seq));
+			}
+		}
+
+		// Events of the type that happened to the subject on or after the tick,
+		// e.g. count(Subject::POST, gamedata.post_idx, PARASITES_ASSAULT, log.tick() - 60)
+		size_t count(Subject subject, uint32_t subject_idx, EventType type, Types::tick_t since) const
+		{
+			size_t n = 0;
+			for_each_of(subject, subject_idx, since, [&](const Entry& val) {
+				if (val.event.type == type && val.event.tick >= since) n++;
+				});
+			return n;
+		}
+
+		// Events of the subject logged on the tick in the order they were logged, as listed in Map layer 1
+		json encodeJSON(Subject subject, uint32_t subject_idx, Types::tick_t tick) const
+		{
+			size_t n = 0;
+			for_each_of(subject, subject_idx, tick, [&](const Entry& val) {
+				if (val.logged == tick) n++;
+				});
+
+			json j = json::array();
+			if (n == 0) return j;
+
+			j = json(n, json());
+			for_each_of(subject, subject_idx, tick, [&](const Entry& val) {
+				if (val.logged == tick) j[--n] = val.event.encodeJSON();
+				});
+			return j;
+		}
+
+	protected:
+
+		uint64_t oldest() const
+		{
+			return next > ring.size() ? next - ring.size() : 0;
+		}
+
+		bool retained(uint64_t seq) const
+		{
+			return seq != NPOS && seq >= oldest();
+		}
+
+		const Entry& entry(uint64_t seq) const
+		{
+			return ring[seq % ring.size()];
+		}
+
+		std::vector<uint64_t>& subject_heads(Subject subject)
+		{
+			return subject == Subject::POST ? post_heads : train_heads;
+		}
+
+		const std::vector<uint64_t>& subject_heads(Subject subject) const
+		{
+			return subject == Subject::POST ? post_heads : train_heads;
+		}
+
+		std::vector<Entry> ring;
+
+		// Sequence number of the next entry, entry n lives in ring[n % capacity]
+		uint64_t next = 0;
+		Types::tick_t current = 0;
+
+		// Newest entry of each post and train, by post_idx and train_idx
+		std::vector<uint64_t> post_heads;
+		std::vector<uint64_t> train_heads;
+	};
+
+} // namespace Events
@@ -0,0 +1,691 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
+
+#include <src/game/data.h>
+#include <src/utils/json_sax_reader.h>
+
+
+// Streaming (SAX) parser of Map layer 1.
+//
+// Fields are written straight into the Player, Train and Post objects of GameData without
+// building a json DOM. Posts and trains are buffered field by field until their object ends,
+// because their idx and type may come after the other keys. Keep one parser per game: the
+// reader and the scratch buffers are reused, so once they have grown to the largest layer seen
+// a parse allocates only for new entities, new player uids and names longer than before.
+// Events are logged once the whole layer is read, as the tick of the layer may come after them.
+// Every field that differs from the stored value is reported in GameData::changes.
+class GameDataL1Parser
+{
+public:
+
+	GameDataL1Parser()
+	{
+		post.events.reserve(8);
+		train.events.reserve(8);
+		events.reserve(64);
+	}
+
+	void parse(GameData& val, const std::string& payload)
+	{
+		gamedata = &val;
+		stack.clear();
+		error.clear();
+		has_error = false;
+		has_tick = false;
+		events.clear();
+
+		val.changes.reset(false);
+
+		reader.parse(payload, *this);
+
+		if (!has_error) apply_events();
+
+		gamedata = nullptr;
+
+		if (has_error) throw std::invalid_argument(error);
+	}
+
+	//------------------------------ SAX INTERFACE ------------------------------//
+
+	bool null()
+	{
+		return value(0, true);
+	}
+
+	bool boolean(bool val)
+	{
+		return value(val, false);
+	}
+
+	bool number_integer(json::number_integer_t val)
+	{
+		return value(val, false);
+	}
+
+	bool number_unsigned(json::number_unsigned_t val)
+	{
+		return value((int64_t)val, false);
+	}
+
+	bool number_float(json::number_float_t val, const json::string_t&)
+	{
+		return value((int64_t)val, false);
+	}
+
+	bool string(json::string_t& val)
+	{
+		switch (top())
+		{
+		case Context::ROOT:
+			if (field == Field::ERROR_TEXT)
+			{
+				error = val;
+				has_error = true;
+			}
+			break;
+		case Context::POST:
+			if (field == Field::NAME) post.name = val;
+			else if (field == Field::PLAYER_IDX) post.player_idx = val;
+			else break;
+			post.seen |= bit(field);
+			break;
+		case Context::TRAIN:
+			if (field == Field::PLAYER_IDX)
+			{
+				train.player_idx = val;
+				train.seen |= bit(field);
+			}
+			break;
+		case Context::PLAYER:
+			if (field == Field::IDX) player.idx = val;
+			else if (field == Field::NAME) player.name = val;
+			else break;
+			player.seen |= bit(field);
+			break;
+		default:
+			break;
+		}
+		return true;
+	}
+
+	bool binary(json::binary_t&)
+	{
+		return true;
+	}
+
+	bool start_object(std::size_t)
+	{
+		if (stack.empty())
+		{
+			stack.push_back(Context::ROOT);
+			return true;
+		}
+
+		switch (top())
+		{
+		case Context::ROOT:
+			stack.push_back(field == Field::RATINGS ? Context::RATINGS : Context::SKIP);
+			break;
+		case Context::POSTS:
+			post.reset();
+			stack.push_back(Context::POST);
+			break;
+		case Context::TRAINS:
+			train.reset();
+			stack.push_back(Context::TRAIN);
+			break;
+		case Context::RATINGS:
+			player.reset();
+			player.uid = player_key;
+			stack.push_back(Context::PLAYER);
+			break;
+		case Context::EVENTS:
+			current_events().emplace_back();
+			stack.push_back(Context::EVENT);
+			break;
+		default:
+			stack.push_back(Context::SKIP);
+			break;
+		}
+		return true;
+	}
+
+	bool end_object()
+	{
+		const Context ctx = top();
+		stack.pop_back();
+
+		switch (ctx)
+		{
+		case Context::POST: apply_post(); break;
+		case Context::TRAIN: apply_train(); break;
+		case Context::PLAYER: apply_player(); break;
+		default: break;
+		}
+
+		field = Field::UNKNOWN;
+		return true;
+	}
+
+	bool start_array(std::size_t)
+	{
+		const Context ctx = stack.empty() ? Context::SKIP : top();
+
+		if (ctx == Context::ROOT && field == Field::POSTS) stack.push_back(Context::POSTS);
+		else if (ctx == Context::ROOT && field == Field::TRAINS) stack.push_back(Context::TRAINS);
+		else if ((ctx == Context::POST || ctx == Context::TRAIN) && field == Field::EVENTS)
+		{
+			events_owner = ctx;
+			current_events().clear();
+			(ctx == Context::POST ? post.seen : train.seen) |= bit(Field::EVENTS);
+			stack.push_back(Context::EVENTS);
+		}
+		else stack.push_back(Context::SKIP);
+
+		return true;
+	}
+
+	bool end_array()
+	{
+		stack.pop_back();
+
+		field = Field::UNKNOWN;
+		return true;
+	}
+
+	bool key(json::string_t& val)
+	{
+		if (top() == Context::RATINGS)
+		{
+			// Ratings are keyed by the player uid
+			player_key = val;
+			return true;
+		}
+
+		field = field_of(val);
+		return true;
+	}
+
+	// Malformed layers end the parse, parse() reports them like a server error
+	bool parse_error(std::size_t position, std::string_view message)
+	{
+		error = "Malformed L1 at " + std::to_string(position) + ": " + std::string(message);
+		has_error = true;
+		return false;
+	}
+
+protected:
+
+	enum class Context : uint8_t
+	{
+		ROOT,
+		POSTS,
+		POST,
+		TRAINS,
+		TRAIN,
+		RATINGS,
+		PLAYER,
+		EVENTS,
+		EVENT,
+		SKIP
+	};
+
+	enum class Field : uint8_t
+	{
+		UNKNOWN,
+		ERROR_TEXT,
+		POSTS,
+		TRAINS,
+		RATINGS,
+		EVENTS,
+		IDX,
+		NAME,
+		POINT_IDX,
+		TYPE,
+		ARMOR,
+		ARMOR_CAPACITY,
+		PRODUCT,
+		PRODUCT_CAPACITY,
+		REPLENISHMENT,
+		LEVEL,
+		PLAYER_IDX,
+		POPULATION,
+		TRAIN_COOLDOWN,
+		COOLDOWN,
+		GOODS,
+		GOODS_TYPE,
+		LINE_IDX,
+		POSITION,
+		SPEED,
+		RATING,
+		TICK,
+		PARASITES_POWER,
+		HIJACKERS_POWER,
+		REFUGEES_NUMBER
+	};
+
+	static uint64_t bit(Field val)
+	{
+		return uint64_t(1) << (uint8_t)val;
+	}
+
+	static Field field_of(std::string_view key)
+	{
+		switch (key.size())
+		{
+		case 3:
+			if (key == "idx") return Field::IDX;
+			break;
+		case 4:
+			if (key == "name") return Field::NAME;
+			if (key == "type") return Field::TYPE;
+			if (key == "tick") return Field::TICK;
+			break;
+		case 5:
+			if (key == "error") return Field::ERROR_TEXT;
+			if (key == "posts") return Field::POSTS;
+			if (key == "armor") return Field::ARMOR;
+			if (key == "level") return Field::LEVEL;
+			if (key == "goods") return Field::GOODS;
+			if (key == "speed") return Field::SPEED;
+			break;
+		case 6:
+			if (key == "trains") return Field::TRAINS;
+			if (key == "events") return Field::EVENTS;
+			if (key == "rating") return Field::RATING;
+			break;
+		case 7:
+			if (key == "ratings") return Field::RATINGS;
+			if (key == "product") return Field::PRODUCT;
+			break;
+		case 8:
+			if (key == "cooldown") return Field::COOLDOWN;
+			if (key == "line_idx") return Field::LINE_IDX;
+			if (key == "position") return Field::POSITION;
+			break;
+		case 9:
+			if (key == "point_idx") return Field::POINT_IDX;
+			break;
+		case 10:
+			if (key == "player_idx") return Field::PLAYER_IDX;
+			if (key == "population") return Field::POPULATION;
+			if (key == "goods_type") return Field::GOODS_TYPE;
+			break;
+		case 13:
+			if (key == "replenishment") return Field::REPLENISHMENT;
+			break;
+		case 14:
+			if (key == "armor_capacity") return Field::ARMOR_CAPACITY;
+			if (key == "train_cooldown") return Field::TRAIN_COOLDOWN;
+			break;
+		case 15:
+			if (key == "parasites_power") return Field::PARASITES_POWER;
+			if (key == "hijackers_power") return Field::HIJACKERS_POWER;
+			if (key == "refugees_number") return Field::REFUGEES_NUMBER;
+			break;
+		case 16:
+			if (key == "product_capacity") return Field::PRODUCT_CAPACITY;
+			break;
+		}
+		return Field::UNKNOWN;
+	}
+
+	//------------------------------ SCRATCH ------------------------------//
+
+	struct event_fields
+	{
+		int64_t type = 0;
+		int64_t tick = 0;
+		int64_t trains = 0;
+		int64_t power = 0;
+		bool has_tick = false;
+	};
+
+	// Event of a post or train, kept until the end of the layer
+	struct pending_event
+	{
+		Events::Subject subject;
+		uint32_t subject_idx;
+		event_fields fields;
+	};
+
+	struct post_fields
+	{
+		uint64_t seen;
+		Types::post_idx_t idx;
+		std::string name;
+		Types::vertex_idx_t point_idx;
+		Posts::PostType type;
+		uint32_t armor, armor_capacity, product, product_capacity, replenishment, population;
+		uint8_t level;
+		std::string player_idx;
+		Types::tick_t train_cooldown;
+		std::vector<event_fields> events;
+
+		void reset()
+		{
+			seen = 0;
+			player_idx.clear();
+			events.clear();
+		}
+	};
+
+	struct train_fields
+	{
+		uint64_t seen;
+		Trains::Train data;
+		std::string player_idx;
+		std::vector<event_fields> events;
+
+		void reset()
+		{
+			seen = 0;
+			player_idx.clear();
+			events.clear();
+		}
+	};
+
+	struct player_fields
+	{
+		uint64_t seen;
+		std::string uid;
+		std::string idx;
+		std::string name;
+		int32_t rating;
+
+		void reset()
+		{
+			seen = 0;
+		}
+	};
+
+	Context top() const
+	{
+		return stack.back();
+	}
+
+	std::vector<event_fields>& current_events()
+	{
+		return events_owner == Context::POST ? post.events : train.events;
+	}
+
+	bool value(int64_t val, bool is_null)
+	{
+		switch (top())
+		{
+		case Context::ROOT:
+			if (field == Field::TICK)
+			{
+				tick = val;
+				has_tick = true;
+			}
+			break;
+		case Context::POST:
+			switch (field)
+			{
+			case Field::IDX: post.idx = (Types::post_idx_t)val; break;
+			case Field::POINT_IDX: post.point_idx = (Types::vertex_idx_t)val; break;
+			case Field::TYPE: post.type = (Posts::PostType)val; break;
+			case Field::ARMOR: post.armor = (uint32_t)val; break;
+			case Field::ARMOR_CAPACITY: post.armor_capacity = (uint32_t)val; break;
+			case Field::PRODUCT: post.product = (uint32_t)val; break;
+			case Field::PRODUCT_CAPACITY: post.product_capacity = (uint32_t)val; break;
+			case Field::REPLENISHMENT: post.replenishment = (uint32_t)val; break;
+			case Field::POPULATION: post.population = (uint32_t)val; break;
+			case Field::LEVEL: post.level = (uint8_t)val; break;
+			case Field::TRAIN_COOLDOWN: post.train_cooldown = val; break;
+			case Field::PLAYER_IDX: if (is_null) post.player_idx.clear(); break;
+			default: return true;
+			}
+			post.seen |= bit(field);
+			break;
+		case Context::TRAIN:
+			switch (field)
+			{
+			case Field::IDX: train.data.idx = (Types::train_idx_t)val; break;
+			case Field::LEVEL: train.data.level = (uint8_t)val; break;
+			case Field::COOLDOWN: train.data.cooldown = val; break;
+			case Field::GOODS: train.data.goods = (uint32_t)val; break;
+			case Field::GOODS_TYPE: train.data.goods_type = is_null ? Trains::None : (Trains::GoodsType)val; break;
+			case Field::LINE_IDX: train.data.line_idx = (Types::edge_idx_t)val; break;
+			case Field::POSITION: train.data.position = (Types::edge_length_t)val; break;
+			case Field::SPEED: train.data.speed = (int8_t)val; break;
+			default: return true;
+			}
+			train.seen |= bit(field);
+			break;
+		case Context::PLAYER:
+			if (field == Field::RATING)
+			{
+				player.rating = (int32_t)val;
+				player.seen |= bit(field);
+			}
+			break;
+		case Context::EVENT:
+		{
+			event_fields& event = current_events().back();
+			switch (field)
+			{
+			case Field::TYPE: event.type = val; break;
+			case Field::TICK: event.tick = val; event.has_tick = true; break;
+			case Field::TRAINS: event.trains = val; break;
+			case Field::PARASITES_POWER:
+			case Field::HIJACKERS_POWER:
+			case Field::REFUGEES_NUMBER: event.power = val; break;
+			default: break;
+			}
+		} break;
+		default:
+			break;
+		}
+		return true;
+	}
+
+	//------------------------------ APPLY ------------------------------//
+
+	// False for an unknown type
+	static bool make_event(Events::Event& event, const event_fields& val, Types::tick_t tick)
+	{
+		event = Events::Event{};
+		event.type = (Events::EventType)val.type;
+		event.tick = val.has_tick ? val.tick : tick;
+
+		switch (event.type)
+		{
+		case Events::TRAIN_COLLISION: event.crash.train = (Types::train_idx_t)val.trains; return true;
+		case Events::PARASITES_ASSAULT:
+		case Events::HIJACKERS_ASSAULT: event.assault.power = (uint8_t)val.power; return true;
+		case Events::REFUGEES_ARRIVAL: event.refugees.number = (uint8_t)val.power; return true;
+		case Events::RESOURCE_OVERFLOW:
+		case Events::RESOURCE_LACK:
+		case Events::GAME_OVER: event.tick = tick; return true;
+		default: return false;
+		}
+	}
+
+	void queue_events(Events::Subject subject, uint32_t subject_idx, const std::vector<event_fields>& vec)
+	{
+		for (const event_fields& val : vec)
+		{
+			events.push_back({ subject, subject_idx, val });
+		}
+	}
+
+	void apply_events()
+	{
+		Events::EventLog& log = gamedata->events;
+		log.begin_tick(has_tick ? tick : log.tick() + 1);
+
+		gamedata->changes.tick = log.tick();
+
+		for (const pending_event& val : events)
+		{
+			Events::Event event;
+			if (make_event(event, val.fields, log.tick()) && log.add(val.subject, val.subject_idx, event))
+			{
+				gamedata->changes.add(Changes::EVENT_ADDED, val.subject_idx, val.subject);
+			}
+		}
+	}
+
+	// Stores the field if it was seen, flagging type in mask when the stored value differs
+	template <class Ty, class Vy>
+	static void assign(Ty& dst, const Vy& val, uint64_t seen, Field field, Changes::ChangeType type, uint32_t& mask)
+	{
+		if (!(seen & bit(field))) return;
+
+		// Same types compare as they are, casting a string would copy it
+		if constexpr (std::is_same_v<Ty, Vy>)
+		{
+			if (dst == val) return;
+			dst = val;
+		}
+		else
+		{
+			if (dst == (Ty)val) return;
+			dst = (Ty)val;
+		}
+
+		mask |= Changes::ChangeList::bit(type);
+	}
+
+	void apply_post()
+	{
+		if (!(post.seen & bit(Field::IDX))) return;
+
+		Posts::PostTables& posts = gamedata->posts;
+		Posts::PostRef ref = posts.find(post.idx);
+
+		uint32_t mask = 0;
+
+		if (ref.type == Posts::NONE)
+		{
+			if (!(post.seen & bit(Field::TYPE))) throw std::invalid_argument("L1 post without type");
+			if (!(post.seen & bit(Field::POINT_IDX))) throw std::invalid_argument("L1 post without point_idx");
+
+			ref = posts.add(post.type, post.idx, post.point_idx);
+			mask |= Changes::ChangeList::bit(Changes::POST_ADDED);
+		}
+
+		gamedata->events.track(Events::Subject::POST, post.idx);
+
+		Posts::PostColumns& columns = posts.columns(ref.type);
+		if (post.seen & bit(Field::NAME)) columns.name[ref.slot] = post.name;
+		if (post.seen & bit(Field::EVENTS)) queue_events(Events::Subject::POST, post.idx, post.events);
+
+		const uint32_t slot = ref.slot;
+		const uint64_t seen = post.seen;
+
+		switch (ref.type)
+		{
+		case Posts::TOWN:
+		{
+			Posts::Towns& towns = posts.towns;
+			assign(towns.armor[slot], post.armor, seen, Field::ARMOR, Changes::POST_STOCK, mask);
+			assign(towns.level[slot], post.level, seen, Field::LEVEL, Changes::POST_LEVEL, mask);
+			if (seen & bit(Field::PLAYER_IDX))
+			{
+				const Types::player_id_t owner = post.player_idx.empty() ? Players::NONE : gamedata->players.intern(post.player_idx);
+				assign(towns.owner[slot], owner, seen, Field::PLAYER_IDX, Changes::POST_OWNER, mask);
+			}
+			assign(towns.population[slot], post.population, seen, Field::POPULATION, Changes::POST_STOCK, mask);
+			assign(towns.product[slot], post.product, seen, Field::PRODUCT, Changes::POST_STOCK, mask);
+			assign(towns.train_cooldown[slot], post.train_cooldown, seen, Field::TRAIN_COOLDOWN, Changes::POST_COOLDOWN, mask);
+		} break;
+		case Posts::MARKET:
+		{
+			Posts::Markets& markets = posts.markets;
+			assign(markets.product[slot], post.product, seen, Field::PRODUCT, Changes::POST_STOCK, mask);
+			assign(markets.product_capacity[slot], post.product_capacity, seen, Field::PRODUCT_CAPACITY, Changes::POST_STOCK, mask);
+			assign(markets.replenishment[slot], post.replenishment, seen, Field::REPLENISHMENT, Changes::POST_STOCK, mask);
+		} break;
+		case Posts::STORAGE:
+		{
+			Posts::Storages& storages = posts.storages;
+			assign(storages.armor[slot], post.armor, seen, Field::ARMOR, Changes::POST_STOCK, mask);
+			assign(storages.armor_capacity[slot], post.armor_capacity, seen, Field::ARMOR_CAPACITY, Changes::POST_STOCK, mask);
+			assign(storages.replenishment[slot], post.replenishment, seen, Field::REPLENISHMENT, Changes::POST_STOCK, mask);
+		} break;
+		default: break;
+		}
+
+		gamedata->changes.add_mask(mask, post.idx);
+	}
+
+	void apply_train()
+	{
+		if (!(train.seen & bit(Field::IDX))) return;
+
+		Trains::TrainTable& trains = gamedata->trains;
+		Trains::Train* val;
+
+		uint32_t mask = 0;
+
+		if (trains.contains(train.data.idx))
+		{
+			val = &trains[train.data.idx];
+		}
+		else
+		{
+			if (!(train.seen & bit(Field::PLAYER_IDX))) throw std::invalid_argument("L1 train without player_idx");
+
+			val = &trains.add(train.data.idx, gamedata->players.intern(train.player_idx));
+			mask |= Changes::ChangeList::bit(Changes::TRAIN_ADDED);
+		}
+
+		gamedata->events.track(Events::Subject::TRAIN, train.data.idx);
+
+		const uint64_t seen = train.seen;
+
+		val->idx = train.data.idx;
+		assign(val->level, train.data.level, seen, Field::LEVEL, Changes::TRAIN_LEVEL, mask);
+		assign(val->cooldown, train.data.cooldown, seen, Field::COOLDOWN, Changes::TRAIN_COOLDOWN, mask);
+		assign(val->goods, train.data.goods, seen, Field::GOODS, Changes::TRAIN_CARGO, mask);
+		assign(val->goods_type, train.data.goods_type, seen, Field::GOODS_TYPE, Changes::TRAIN_CARGO, mask);
+		assign(val->line_idx, train.data.line_idx, seen, Field::LINE_IDX, Changes::TRAIN_MOVED, mask);
+		assign(val->position, train.data.position, seen, Field::POSITION, Changes::TRAIN_MOVED, mask);
+		assign(val->speed, train.data.speed, seen, Field::SPEED, Changes::TRAIN_MOVED, mask);
+		if (seen & bit(Field::EVENTS)) queue_events(Events::Subject::TRAIN, train.data.idx, train.events);
+
+		gamedata->changes.add_mask(mask, train.data.idx);
+	}
+
+	void apply_player()
+	{
+		const size_t num_players = gamedata->players.size();
+		const Types::player_id_t id = gamedata->players.intern(player.uid);
+		Player& val = gamedata->players[id];
+
+		uint32_t mask = id >= num_players ? Changes::ChangeList::bit(Changes::PLAYER_CHANGED) : 0;
+
+		assign(val.idx, player.idx, player.seen, Field::IDX, Changes::PLAYER_CHANGED, mask);
+		assign(val.name, player.name, player.seen, Field::NAME, Changes::PLAYER_CHANGED, mask);
+		assign(val.rating, player.rating, player.seen, Field::RATING, Changes::PLAYER_CHANGED, mask);
+
+		gamedata->changes.add_mask(mask, id);
+	}
+
+	GameData* gamedata = nullptr;
+
+	json_sax_reader reader;
+	std::vector<Context> stack;
+	Field field = Field::UNKNOWN;
+	Context events_owner = Context::POST;
+
+	post_fields post;
+	train_fields train;
+	player_fields player;
+	std::string player_key;
+
+	std::vector<pending_event> events;
+	Types::tick_t tick = 0;
+	bool has_tick = false;
+
+	std::string error;
+	bool has_error = false;
+};
@@ -2,6 +2,8 @@
 
 #include <src/game/data/base_json_encodable.h>
 #include <map>
+#include <vector>
+#include <stdexcept>
 
 
 struct Player : base_json_encodable
@@ -10,8 +12,6 @@ struct Player : base_json_encodable
 	std::string name;
 	int32_t rating;
 
-	std::map<Types::train_idx_t, Trains::Train> trains;
-
 	json encodeJSON() const
 	{
 		json j;
@@ -30,12 +30,76 @@ struct Player : base_json_encodable
 		j["rating"].get_to(val.rating);
 	}
 
-	static void updateJSON_L1(Player& val, const json& j)
+	CLASS_VIRTUAL_DESTRUCTOR(Player);
+};
+
+
+// Players indexed by a dense id.
+// Uid strings are interned once, when the player is first seen; everything else refers to players by id.
+struct Players
+{
+	static constexpr Types::player_id_t NONE = UINT8_MAX;
+
+	size_t size() const
 	{
-		//j["idx"].get_to(val.idx);
-		//j["name"].get_to(val.name);
-		j["rating"].get_to(val.rating);
+		return rows.size();
 	}
 
-	CLASS_VIRTUAL_DESTRUCTOR(Player);
-};
\ No newline at end of file
+	void clear()
+	{
+		rows.clear();
+		ids.clear();
+	}
+
+	Player& operator[](Types::player_id_t id)
+	{
+		return rows[id];
+	}
+
+	const Player& operator[](Types::player_id_t id) const
+	{
+		return rows[id];
+	}
+
+	std::vector<Player>::iterator begin() { return rows.begin(); }
+	std::vector<Player>::iterator end() { return rows.end(); }
+	std::vector<Player>::const_iterator begin() const { return rows.begin(); }
+	std::vector<Player>::const_iterator end() const { return rows.end(); }
+
+	// NONE if the uid was never interned
+	Types::player_id_t find(const Types::player_uid_t& uid) const
+	{
+		const auto it = ids.find(uid);
+		return it != ids.end() ? it->second : NONE;
+	}
+
+	// Id of the uid, adds an empty player the first time it is seen
+	Types::player_id_t intern(const Types::player_uid_t& uid)
+	{
+		const auto it = ids.find(uid);
+		if (it != ids.end()) return it->second;
+
+		if (rows.size() >= NONE) throw std::length_error("Too many players");
+
+		const Types::player_id_t id = (Types::player_id_t)rows.size();
+
+		Player& player = rows.emplace_back();
+		player.idx = uid;
+		player.rating = 0;
+
+		ids.emplace(uid, id);
+		return id;
+	}
+
+	// Empty for NONE, as the server encodes a town without owner
+	const Types::player_uid_t& uid(Types::player_id_t id) const
+	{
+		static const Types::player_uid_t none;
+		return id < rows.size() ? rows[id].idx : none;
+	}
+
+protected:
+
+	std::vector<Player> rows;
+	std::map<Types::player_uid_t, Types::player_id_t> ids;
+};
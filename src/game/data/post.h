@@ -1,7 +1,12 @@
 #pragma once
 
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
 #include <src/game/data/base_json_encodable.h>
-#include <boost/ptr_container/ptr_vector.hpp>
+#include <src/game/data/player.h>
 
 
 namespace Posts {
@@ -10,212 +15,385 @@ namespace Posts {
 
 	enum PostType : uint8_t
 	{
+		NONE = 0,
 		TOWN = 1,
 		MARKET = 2,
 		STORAGE = 3
 	};
 
-	struct Post : public base_json_encodable
+	struct Town_Tier
 	{
-		Types::vertex_idx_t idx;
-		std::string name;
-		Types::vertex_idx_t point_idx;
-
-		boost::ptr_vector<Events::Event> events;
+		const uint32_t population_capacity;
+		const uint32_t product_capacity;
+		const uint32_t armor_capacity;
+		const Types::tick_t cooldown_after_crash;
+		const uint64_t next_level_price;
+	};
 
-		virtual PostType type() const = 0;
+	const Town_Tier TownTiers[3]
+	{
+		{10, 200, 200, 2, 100},
+		{20, 500, 500, 1, 200},
+		{40, 10000, 10000, 0, UINT32_MAX}
+	};
 
-		virtual json encodeJSON() const = 0;
+	// Location of a post in the table of its type
+	struct PostRef
+	{
+		PostType type = PostType::NONE;
+		uint32_t slot = 0;
 
-		CLASS_VIRTUAL_DESTRUCTOR(Post);
+		bool operator==(const PostRef& other) const { return type == other.type && slot == other.slot; }
+		bool operator!=(const PostRef& other) const { return !(*this == other); }
 	};
 
-	struct Storage : public Post
+	//------------------------------ TABLES ------------------------------//
+
+	// Columns shared by every post type, one row per post
+	struct PostColumns
 	{
-		uint32_t armor;
-		uint32_t armor_capacity;
-		uint32_t replenishment;
+		std::vector<Types::post_idx_t> idx;
+		std::vector<std::string> name;
+		std::vector<Types::vertex_idx_t> point_idx;
+
+		uint32_t size() const
+		{
+			return (uint32_t)idx.size();
+		}
 
-		PostType type() const { return PostType::STORAGE; }
+	protected:
 
-		json encodeJSON() const
+		uint32_t add_row(Types::post_idx_t post_idx, Types::vertex_idx_t post_point_idx)
 		{
-			json j;
-			j["idx"] = idx;
-			j["name"] = name;
-			j["point_idx"] = point_idx;
+			idx.push_back(post_idx);
+			name.emplace_back();
+			point_idx.push_back(post_point_idx);
 
-			j["armor"] = armor;
-			j["armor_capacity"] = armor_capacity;
-			j["replenishment"] = replenishment;
+			return size() - 1;
+		}
+
+		void clear_rows()
+		{
+			idx.clear();
+			name.clear();
+			point_idx.clear();
+		}
+
+		json encodeJSON_row(uint32_t slot, PostType type) const
+		{
+			json j;
+			j["idx"] = idx[slot];
+			j["name"] = name[slot];
+			j["point_idx"] = point_idx[slot];
+			j["type"] = type;
 			return j;
 		}
+	};
+
+	struct Storages : public PostColumns
+	{
+		std::vector<uint32_t> armor;
+		std::vector<uint32_t> armor_capacity;
+		std::vector<uint32_t> replenishment;
 
-		[[nodiscard]]
-		static Storage* readJSON_L1(const json& j)
+		uint32_t add(Types::post_idx_t post_idx, Types::vertex_idx_t post_point_idx)
 		{
-			Storage* ptr = new Storage;
+			armor.push_back(0);
+			armor_capacity.push_back(0);
+			replenishment.push_back(0);
+
+			return add_row(post_idx, post_point_idx);
+		}
 
-			j["armor"].get_to(ptr->armor);
-			j["armor_capacity"].get_to(ptr->armor_capacity);
-			j["replenishment"].get_to(ptr->replenishment);
+		void clear()
+		{
+			clear_rows();
+			armor.clear();
+			armor_capacity.clear();
+			replenishment.clear();
+		}
 
-			return ptr;
+		// One tick of replenishment for every storage
+		void replenish()
+		{
+			for (uint32_t i = 0; i < size(); i++)
+			{
+				armor[i] = std::min(armor_capacity[i], armor[i] + replenishment[i]);
+			}
 		}
 
-		static void updateJSON_L1(Storage* ptr, const json& j)
+		json encodeJSON(uint32_t slot) const
 		{
-			j["armor"].get_to(ptr->armor);
-			//j["armor_capacity"].get_to(ptr->armor_capacity);
-			//j["replenishment"].get_to(ptr->replenishment);
+			json j = encodeJSON_row(slot, PostType::STORAGE);
+			j["armor"] = armor[slot];
+			j["armor_capacity"] = armor_capacity[slot];
+			j["replenishment"] = replenishment[slot];
+			return j;
 		}
 
-		CLASS_VIRTUAL_DESTRUCTOR(Storage);
+		void readJSON_L1(uint32_t slot, const json& j)
+		{
+			j["armor"].get_to(armor[slot]);
+			j["armor_capacity"].get_to(armor_capacity[slot]);
+			j["replenishment"].get_to(replenishment[slot]);
+		}
 	};
 
-	struct Market : public Post
+	struct Markets : public PostColumns
 	{
-		uint32_t product;
-		uint32_t product_capacity;
-		uint32_t replenishment;
+		std::vector<uint32_t> product;
+		std::vector<uint32_t> product_capacity;
+		std::vector<uint32_t> replenishment;
 
-		PostType type() const { return PostType::MARKET; }
+		uint32_t add(Types::post_idx_t post_idx, Types::vertex_idx_t post_point_idx)
+		{
+			product.push_back(0);
+			product_capacity.push_back(0);
+			replenishment.push_back(0);
+
+			return add_row(post_idx, post_point_idx);
+		}
 
-		json encodeJSON() const
+		void clear()
 		{
-			json j;
-			j["idx"] = idx;
-			j["name"] = name;
-			j["point_idx"] = point_idx;
+			clear_rows();
+			product.clear();
+			product_capacity.clear();
+			replenishment.clear();
+		}
 
-			j["product"] = product;
-			j["product_capacity"] = product_capacity;
-			j["replenishment"] = replenishment;
+		// One tick of replenishment for every market
+		void replenish()
+		{
+			for (uint32_t i = 0; i < size(); i++)
+			{
+				product[i] = std::min(product_capacity[i], product[i] + replenishment[i]);
+			}
+		}
+
+		json encodeJSON(uint32_t slot) const
+		{
+			json j = encodeJSON_row(slot, PostType::MARKET);
+			j["product"] = product[slot];
+			j["product_capacity"] = product_capacity[slot];
+			j["replenishment"] = replenishment[slot];
 			return j;
 		}
 
-		[[nodiscard]]
-		static Market* readJSON_L1(const json& j)
+		void readJSON_L1(uint32_t slot, const json& j)
 		{
-			Market* ptr = new Market;
+			j["product"].get_to(product[slot]);
+			j["product_capacity"].get_to(product_capacity[slot]);
+			j["replenishment"].get_to(replenishment[slot]);
+		}
+	};
 
-			j["product"].get_to(ptr->product);
-			j["product_capacity"].get_to(ptr->product_capacity);
-			j["replenishment"].get_to(ptr->replenishment);
+	struct Towns : public PostColumns
+	{
+		static constexpr uint32_t NPOS = UINT32_MAX;
+
+		std::vector<uint32_t> armor;
+		std::vector<uint8_t> level;
+		std::vector<Types::player_id_t> owner;
+		std::vector<uint32_t> population;
+		std::vector<uint32_t> product;
+		std::vector<Types::tick_t> train_cooldown;
 
-			return ptr;
+		uint32_t add(Types::post_idx_t post_idx, Types::vertex_idx_t post_point_idx)
+		{
+			armor.push_back(0);
+			level.push_back(1);
+			owner.push_back(Players::NONE);
+			population.push_back(0);
+			product.push_back(0);
+			train_cooldown.push_back(0);
+
+			return add_row(post_idx, post_point_idx);
 		}
 
-		static void updateJSON_L1(Market* ptr, const json& j)
+		void clear()
 		{
-			j["product"].get_to(ptr->product);
-			//j["product_capacity"].get_to(ptr->product_capacity);
-			//j["replenishment"].get_to(ptr->replenishment);
+			clear_rows();
+			armor.clear();
+			level.clear();
+			owner.clear();
+			population.clear();
+			product.clear();
+			train_cooldown.clear();
 		}
 
-		CLASS_VIRTUAL_DESTRUCTOR(Market);
-	};
+		// Slot of the first town owned by the player, NPOS if none; Players::NONE finds a free town
+		uint32_t find_owned(Types::player_id_t player) const
+		{
+			const auto it = std::find(owner.begin(), owner.end(), player);
+			return it != owner.end() ? (uint32_t)(it - owner.begin()) : NPOS;
+		}
 
-	struct Town_Tier
-	{
-		const uint32_t population_capacity;
-		const uint32_t product_capacity;
-		const uint32_t armor_capacity;
-		const Types::tick_t cooldown_after_crash;
-		const uint64_t next_level_price;
+		json encodeJSON(uint32_t slot, const Players& players) const
+		{
+			json j = encodeJSON_row(slot, PostType::TOWN);
+			j["armor"] = armor[slot];
+			j["level"] = level[slot];
+			if (owner[slot] == Players::NONE) j["player_idx"] = nullptr;
+			else j["player_idx"] = players.uid(owner[slot]);
+			j["population"] = population[slot];
+			j["product"] = product[slot];
+			j["train_cooldown"] = train_cooldown[slot];
+			return j;
+		}
+
+		void readJSON_L1(uint32_t slot, const json& j, Players& players)
+		{
+			j["armor"].get_to(armor[slot]);
+			j["level"].get_to(level[slot]);
+			if (j["player_idx"].is_null() || j["player_idx"].get_ref<const Types::player_uid_t&>().empty()) owner[slot] = Players::NONE;
+			else owner[slot] = players.intern(j["player_idx"].get_ref<const Types::player_uid_t&>());
+			j["population"].get_to(population[slot]);
+			j["product"].get_to(product[slot]);
+			j["train_cooldown"].get_to(train_cooldown[slot]);
+		}
 	};
 
-	struct Town : public Post
+	// Posts stored by type in contiguous columns.
+	// A dense index maps post_idx to its (type, slot), another one maps the vertex idx of the post.
+	// Rows are only appended, so slots stay valid for the whole game.
+	struct PostTables
 	{
-		uint32_t armor;
-		uint8_t level;
-		Types::player_uid_t player_idx;
-		uint32_t population;
-		uint32_t product;
-		Types::tick_t train_cooldown;
+		Towns towns;
+		Markets markets;
+		Storages storages;
 
-		PostType type() const { return PostType::TOWN; }
+		uint32_t size() const
+		{
+			return towns.size() + markets.size() + storages.size();
+		}
 
-		json encodeJSON() const
+		bool empty() const
 		{
-			json j;
-			j["idx"] = idx;
-			j["name"] = name;
-			j["point_idx"] = point_idx;
-
-			j["armor"] = armor;
-			j["level"] = level;
-			j["player_idx"] = player_idx;
-			j["population"] = population;
-			j["product"] = product;
-			j["train_cooldown"] = train_cooldown;
-			return j;
+			return size() == 0;
 		}
 
-		[[nodiscard]]
-		static Town* readJSON_L1(const json& j)
+		void clear()
 		{
-			Town* ptr = new Town;
+			towns.clear();
+			markets.clear();
+			storages.clear();
 
-			j["armor"].get_to(ptr->armor);
-			j["level"].get_to(ptr->level);
-			ptr->player_idx = j["player_idx"].is_null() ? "" : j["player_idx"].get<Types::player_uid_t>();
-			j["population"].get_to(ptr->population);
-			j["product"].get_to(ptr->product);
-			j["train_cooldown"].get_to(ptr->train_cooldown);
+			index.clear();
+			vertex_index.clear();
+		}
 
-			return ptr;
+		// Type NONE if there is no such post
+		PostRef find(Types::post_idx_t post_idx) const
+		{
+			return post_idx < index.size() ? index[post_idx] : PostRef();
 		}
 
-		static void updateJSON_L1(Town* ptr, const json& j)
+		// Post standing at the vertex, type NONE if there is none
+		PostRef at_vertex(Types::vertex_idx_t vertex_idx) const
 		{
-			j["armor"].get_to(ptr->armor);
-			j["level"].get_to(ptr->level);
-			//j["player_idx"].get_to(ptr->player_idx);
-			j["population"].get_to(ptr->population);
-			j["product"].get_to(ptr->product);
-			j["train_cooldown"].get_to(ptr->train_cooldown);
+			return vertex_idx < vertex_index.size() ? vertex_index[vertex_idx] : PostRef();
 		}
 
-		CLASS_VIRTUAL_DESTRUCTOR(Town);
-	};
+		PostRef add(PostType type, Types::post_idx_t post_idx, Types::vertex_idx_t point_idx)
+		{
+			PostRef ref;
+			ref.type = type;
 
-	[[nodiscard]]
-	inline Post* make_Post(const json& j)
-	{
-		PostType post_type = (PostType)j["type"].get<uint8_t>();
+			switch (type)
+			{
+			case PostType::TOWN:	ref.slot = towns.add(post_idx, point_idx); break;
+			case PostType::MARKET:	ref.slot = markets.add(post_idx, point_idx); break;
+			case PostType::STORAGE:	ref.slot = storages.add(post_idx, point_idx); break;
+			default:				throw std::invalid_argument("Unknown post type " + std::to_string(type));
+			}
+
+			if (post_idx >= index.size()) index.resize(post_idx + 1);
+			index[post_idx] = ref;
 
-		Post* ptr;
+			if (point_idx >= vertex_index.size()) vertex_index.resize(point_idx + 1);
+			vertex_index[point_idx] = ref;
+
+			return ref;
+		}
+
+		PostColumns& columns(PostType type)
+		{
+			switch (type)
+			{
+			case PostType::TOWN:	return towns;
+			case PostType::MARKET:	return markets;
+			case PostType::STORAGE:	return storages;
+			default:				throw std::invalid_argument("Unknown post type " + std::to_string(type));
+			}
+		}
 
-		switch (post_type)
+		const PostColumns& columns(PostType type) const
 		{
-		case PostType::TOWN:	ptr = reinterpret_cast<Post*>(Town::readJSON_L1(j)); break;
-		case PostType::MARKET:	ptr = reinterpret_cast<Post*>(Market::readJSON_L1(j)); break;
-		case PostType::STORAGE:	ptr = reinterpret_cast<Post*>(Storage::readJSON_L1(j)); break;
-		default:				return nullptr;
+			return const_cast<PostTables*>(this)->columns(type);
 		}
 
-		j["idx"].get_to(ptr->idx);
-		j["name"].get_to(ptr->name);
-		j["point_idx"].get_to(ptr->point_idx);
+		// Calls f(post_idx, ref) for every post in post_idx order
+		template <class Func>
+		void for_each(Func f) const
+		{
+			for (Types::post_idx_t post_idx = 0; post_idx < index.size(); post_idx++)
+			{
+				if (index[post_idx].type != PostType::NONE) f(post_idx, index[post_idx]);
+			}
+		}
 
-		Events::make_Event_vector(ptr->events, j);
+		json encodeJSON(PostRef ref, const Players& players) const
+		{
+			switch (ref.type)
+			{
+			case PostType::TOWN:	return towns.encodeJSON(ref.slot, players);
+			case PostType::MARKET:	return markets.encodeJSON(ref.slot);
+			case PostType::STORAGE:	return storages.encodeJSON(ref.slot);
+			default:				return nullptr;
+			}
+		}
 
-		return ptr;
-	}
+		json encodeJSON(Types::post_idx_t post_idx, const Players& players) const
+		{
+			return encodeJSON(find(post_idx), players);
+		}
 
-	inline void updateJSON_L1(Post* ptr, const json& j)
-	{
-		PostType post_type = ptr->type();
+		// Reads every field of the post, adding it if it is seen for the first time
+		static PostRef readJSON_L1(PostTables& val, const json& j, Players& players)
+		{
+			const Types::post_idx_t post_idx = j["idx"].get<Types::post_idx_t>();
+
+			PostRef ref = val.find(post_idx);
+			if (ref.type == PostType::NONE)
+			{
+				ref = val.add((PostType)j["type"].get<uint8_t>(), post_idx, j["point_idx"].get<Types::vertex_idx_t>());
+			}
+
+			switch (ref.type)
+			{
+			case PostType::TOWN:	val.towns.readJSON_L1(ref.slot, j, players); break;
+			case PostType::MARKET:	val.markets.readJSON_L1(ref.slot, j); break;
+			case PostType::STORAGE:	val.storages.readJSON_L1(ref.slot, j); break;
+			default:				break;
+			}
+
+			PostColumns& columns = val.columns(ref.type);
+			j["name"].get_to(columns.name[ref.slot]);
+
+			return ref;
+		}
 
-		switch (post_type)
+		// True when both hold the same posts in the same slots, so their columns compare row by row
+		bool same_layout(const PostTables& other) const
 		{
-		case PostType::TOWN:	Town::updateJSON_L1(dynamic_cast<Town*>(ptr), j); break;
-		case PostType::MARKET:	Market::updateJSON_L1(dynamic_cast<Market*>(ptr), j); break;
-		case PostType::STORAGE:	Storage::updateJSON_L1(dynamic_cast<Storage*>(ptr), j); break;
+			return index == other.index;
 		}
 
-		Events::make_Event_vector(ptr->events, j);
-	}
+	protected:
+
+		std::vector<PostRef> index;
+		std::vector<PostRef> vertex_index;
+	};
 
-} // namespace Posts
\ No newline at end of file
+} // namespace Posts
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+
 #include <src/game/data/base_json_encodable.h>
-#include <boost/ptr_container/ptr_vector.hpp>
+#include <src/game/data/player.h>
 
 
 namespace Trains {
@@ -38,12 +41,9 @@ namespace Trains {
 		uint32_t goods;
 		GoodsType goods_type;
 		Types::edge_idx_t line_idx;
-		Types::player_uid_t player_idx;
 		Types::edge_length_t position;
 		int8_t speed;
 
-		boost::ptr_vector<Events::Event> events;
-
 		json encodeJSON() const
 		{
 			json j;
@@ -55,7 +55,6 @@ namespace Trains {
 			j["goods"] = goods;
 			j["goods_type"] = goods_type;
 			j["line_idx"] = line_idx;
-			j["player_idx"] = player_idx;
 			j["position"] = position;
 			j["speed"] = speed;
 
@@ -71,30 +70,112 @@ namespace Trains {
 			j["goods"].get_to(val.goods);
 			val.goods_type = j["goods_type"].is_null() ? GoodsType::None : j["goods_type"].get<GoodsType>();
 			j["line_idx"].get_to(val.line_idx);
-			j["player_idx"].get_to(val.player_idx);
 			j["position"].get_to(val.position);
 			j["speed"].get_to(val.speed);
+		}
+
+	};
+
+	// Every train of the game, indexed directly by train_idx, with the owner kept in its own column.
+	// Rows may move when a train with a larger idx is added, so hold train_idx rather than references.
+	struct TrainTable
+	{
+		// Rows of idxs without a train are unused and owned by Players::NONE
+		std::vector<Train> rows;
+		std::vector<Types::player_id_t> owner;
 
-			Events::make_Event_vector(val.events, j);
+		// Idxs of the existing trains, ascending
+		std::vector<Types::train_idx_t> ids;
+
+		size_t size() const
+		{
+			return ids.size();
 		}
 
-		static void updateJSON_L1(Train& val, const json& j)
+		bool empty() const
 		{
-			//j["idx"].get_to(val.idx);
-			j["level"].get_to(val.level);
-			j["cooldown"].get_to(val.cooldown);
-			//DISABLED j["fuel"].get_to(val.fuel);
-			j["goods"].get_to(val.goods);
-			val.goods_type = j["goods_type"].is_null() ? GoodsType::None : j["goods_type"].get<GoodsType>();
-			j["line_idx"].get_to(val.line_idx);
-			//j["player_idx"].get_to(val.player_idx);
-			j["position"].get_to(val.position);
-			j["speed"].get_to(val.speed);
+			return ids.empty();
+		}
+
+		void clear()
+		{
+			rows.clear();
+			owner.clear();
+			ids.clear();
+		}
 
-			Events::make_Event_vector(val.events, j);
+		bool contains(Types::train_idx_t train_idx) const
+		{
+			return train_idx < owner.size() && owner[train_idx] != Players::NONE;
 		}
-	};
 
+		Train& operator[](Types::train_idx_t train_idx)
+		{
+			return rows[train_idx];
+		}
 
+		const Train& operator[](Types::train_idx_t train_idx) const
+		{
+			return rows[train_idx];
+		}
+
+		Train& at(Types::train_idx_t train_idx)
+		{
+			if (!contains(train_idx)) throw std::out_of_range("No train " + std::to_string(train_idx));
+			return rows[train_idx];
+		}
+
+		const Train& at(Types::train_idx_t train_idx) const
+		{
+			return const_cast<TrainTable*>(this)->at(train_idx);
+		}
+
+		Train& add(Types::train_idx_t train_idx, Types::player_id_t player)
+		{
+			if (train_idx >= rows.size())
+			{
+				rows.resize(train_idx + 1);
+				owner.resize(train_idx + 1, Players::NONE);
+			}
+
+			if (owner[train_idx] == Players::NONE)
+			{
+				ids.insert(std::upper_bound(ids.begin(), ids.end(), train_idx), train_idx);
+			}
+
+			owner[train_idx] = player;
+
+			Train& train = rows[train_idx];
+			train.idx = train_idx;
+			return train;
+		}
+
+		// Calls f(train) for every train of the player, in idx order
+		template <class Func>
+		void for_each_owned(Types::player_id_t player, Func f) const
+		{
+			for (Types::train_idx_t train_idx : ids)
+			{
+				if (owner[train_idx] == player) f(rows[train_idx]);
+			}
+		}
+
+		json encodeJSON(Types::train_idx_t train_idx, const Players& players) const
+		{
+			json j = rows[train_idx].encodeJSON();
+			j["player_idx"] = players.uid(owner[train_idx]);
+			return j;
+		}
+
+		// Reads every field of the train, adding it if it is seen for the first time
+		static void readJSON_L1(TrainTable& val, const json& j, Players& players)
+		{
+			const Types::train_idx_t train_idx = j["idx"].get<Types::train_idx_t>();
+
+			Train& train = val.contains(train_idx) ? val[train_idx] : val.add(train_idx, players.intern(j["player_idx"].get_ref<const Types::player_uid_t&>()));
+
+			Train::readJSON_L1(train, j);
+		}
+	};
 
 } // namespace Trains
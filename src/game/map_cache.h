@@ -0,0 +1,409 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <stdexcept>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <src/game/data.h>
+
+
+// On-disk map cache files, one per L0 payload and one per L0 + L10 payload pair.
+//
+// File layout (native byte order, every section 8-byte aligned so it can be read in place from a mapping):
+//   map_cache_format::header
+//   graph file:  vertex_record[num_vertices] in descriptor order, edge_record[num_edges] in insertion order
+//   coords file: coords_record[num_vertices] in descriptor order
+namespace map_cache_format {
+
+	constexpr char MAGIC[8] = { 'T', '6', 'M', 'A', 'P', 0, 0, 0 };
+	constexpr uint32_t VERSION = 1;
+
+	enum kind_t : uint32_t
+	{
+		GRAPH = 1,
+		COORDS = 2
+	};
+
+	struct header
+	{
+		char magic[8];
+		uint32_t version;
+		kind_t kind;
+
+		// Hashes of the payloads the file was built from, l10_hash is 0 for graph files
+		uint64_t l0_hash;
+		uint64_t l10_hash;
+
+		uint32_t num_vertices;
+		uint32_t num_edges;
+
+		Types::position_t width;
+		Types::position_t height;
+	};
+
+	struct vertex_record
+	{
+		Types::vertex_idx_t idx;
+		Types::post_idx_t post_idx;
+	};
+
+	struct edge_record
+	{
+		Types::edge_idx_t idx;
+		Types::edge_length_t length;
+		Types::vertex_idx_t source;
+		Types::vertex_idx_t target;
+	};
+
+	struct coords_record
+	{
+		double x;
+		double y;
+	};
+
+	static_assert(sizeof(header) % 8 == 0 && sizeof(vertex_record) % 8 == 0 && sizeof(edge_record) % 8 == 0, "Unaligned map cache records");
+}
+
+
+// Process-wide cache of parsed maps, so sessions playing the same map share one read-only graph.
+// Entries are keyed by the hash of the raw L0 / L10 payloads.
+//
+// With a directory set, maps also persist across runs: a miss in memory maps the cached file and
+// rebuilds the graph straight from its records, only a miss on disk parses the payload and writes the file.
+class map_cache
+{
+public:
+
+	using hash_t = uint64_t;
+
+	// Stable across processes and platforms, unlike std::hash (FNV-1a)
+	static hash_t hash_payload(const std::string& payload)
+	{
+		hash_t hash = 14695981039346656037ull;
+		for (const char c : payload)
+		{
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Directory of the on-disk cache, disabled when empty
+	std::string directory;
+
+	void readJSON_L0(GameData& val, const std::string& payload)
+	{
+		const hash_t key = hash_payload(payload);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const auto it = graphs.find(key);
+		if (it != graphs.end())
+		{
+			LOG_2("map_cache::readJSON_L0: Cache hit");
+			val.map_graph = it->second;
+			return;
+		}
+
+		if (!load_graph(val, key))
+		{
+			LOG_2("map_cache::readJSON_L0: Cache miss, parsing...");
+			GameData::readJSON_L0(val, json::parse(payload));
+			save_graph(val, key);
+		}
+
+		graphs.emplace(key, val.map_graph);
+		graph_keys.emplace(val.map_graph.get(), key);
+	}
+
+	void readJSON_L10(GameData& val, const std::string& payload)
+	{
+		// Coordinates are bound to vertex descriptors of a particular graph
+		const std::pair<const GraphIdx*, hash_t> key = { val.map_graph.get(), hash_payload(payload) };
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const auto it = coords.find(key);
+		if (it != coords.end())
+		{
+			LOG_2("map_cache::readJSON_L10: Cache hit");
+			val.map_graph_coords = it->second.map_graph_coords;
+			val.map_graph_width = it->second.map_graph_width;
+			val.map_graph_height = it->second.map_graph_height;
+			return;
+		}
+
+		// Graphs that did not come through the cache have no L0 hash to key the file with
+		const auto graph_key = graph_keys.find(key.first);
+
+		if (graph_key == graph_keys.end() || !load_coords(val, graph_key->second, key.second))
+		{
+			LOG_2("map_cache::readJSON_L10: Cache miss, parsing...");
+			GameData::readJSON_L10(val, json::parse(payload));
+			if (graph_key != graph_keys.end()) save_coords(val, graph_key->second, key.second);
+		}
+
+		coords.emplace(key, coords_entry{ val.map_graph_coords, val.map_graph_width, val.map_graph_height });
+	}
+
+	// Only forgets the maps held in memory, cached files stay on disk
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		coords.clear();
+		graph_keys.clear();
+		graphs.clear();
+	}
+
+protected:
+
+	struct coords_entry
+	{
+		std::shared_ptr<const CoordsHolder> map_graph_coords;
+		Types::position_t map_graph_width;
+		Types::position_t map_graph_height;
+	};
+
+	struct coords_key_hash
+	{
+		size_t operator()(const std::pair<const GraphIdx*, hash_t>& key) const
+		{
+			return std::hash<const GraphIdx*>()(key.first) ^ (size_t)(key.second * 31);
+		}
+	};
+
+	std::mutex mutex;
+
+	std::unordered_map<hash_t, std::shared_ptr<const GraphIdx>> graphs;
+	std::unordered_map<const GraphIdx*, hash_t> graph_keys;
+	std::unordered_map<std::pair<const GraphIdx*, hash_t>, coords_entry, coords_key_hash> coords;
+
+	//------------------------------ DISK ------------------------------//
+
+	static std::string hex(hash_t hash)
+	{
+		std::stringstream ss;
+		ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+		return ss.str();
+	}
+
+	std::string graph_path(hash_t l0_hash) const
+	{
+		return (std::filesystem::path(directory) / (hex(l0_hash) + ".graph")).string();
+	}
+
+	std::string coords_path(hash_t l0_hash, hash_t l10_hash) const
+	{
+		return (std::filesystem::path(directory) / (hex(l0_hash) + "-" + hex(l10_hash) + ".coords")).string();
+	}
+
+	static map_cache_format::header make_header(map_cache_format::kind_t kind, hash_t l0_hash, hash_t l10_hash)
+	{
+		map_cache_format::header h;
+		std::memset(&h, 0, sizeof(h));
+		std::memcpy(h.magic, map_cache_format::MAGIC, sizeof(h.magic));
+		h.version = map_cache_format::VERSION;
+		h.kind = kind;
+		h.l0_hash = l0_hash;
+		h.l10_hash = l10_hash;
+		return h;
+	}
+
+	// Checks the header and that the records it announces fit in the file
+	static const map_cache_format::header& check_header(const boost::interprocess::mapped_region& region, map_cache_format::kind_t kind, hash_t l0_hash, hash_t l10_hash)
+	{
+		if (region.get_size() < sizeof(map_cache_format::header)) throw std::runtime_error("Map cache file is truncated");
+
+		const map_cache_format::header& h = *static_cast<const map_cache_format::header*>(region.get_address());
+
+		if (std::memcmp(h.magic, map_cache_format::MAGIC, sizeof(h.magic)) != 0) throw std::runtime_error("Not a map cache file");
+		if (h.version != map_cache_format::VERSION) throw std::runtime_error("Unsupported map cache version " + std::to_string(h.version));
+		if (h.kind != kind || h.l0_hash != l0_hash || h.l10_hash != l10_hash) throw std::runtime_error("Map cache file does not match the payload");
+
+		const size_t size = sizeof(h) + (kind == map_cache_format::GRAPH
+			? h.num_vertices * sizeof(map_cache_format::vertex_record) + h.num_edges * sizeof(map_cache_format::edge_record)
+			: h.num_vertices * sizeof(map_cache_format::coords_record));
+
+		if (region.get_size() < size) throw std::runtime_error("Map cache file is truncated");
+
+		return h;
+	}
+
+	// Writes through a temporary file, so a concurrent reader never maps a partial file
+	void write_file(const std::string& path, const std::vector<char>& data) const
+	{
+		try
+		{
+			std::filesystem::create_directories(directory);
+
+			const std::string tmp_path = path + ".tmp";
+			{
+				std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+				if (!file.is_open()) throw std::runtime_error("Failed to create " + tmp_path);
+
+				file.write(data.data(), data.size());
+				if (!file) throw std::runtime_error("Failed to write " + tmp_path);
+			}
+
+			std::filesystem::rename(tmp_path, path);
+		}
+		catch (const std::exception& err)
+		{
+			LOG("map_cache: Failed to save " << path << ": " << err.what());
+		}
+	}
+
+	template <class Ty>
+	static void append(std::vector<char>& data, const Ty& val)
+	{
+		const char* bytes = reinterpret_cast<const char*>(&val);
+		data.insert(data.end(), bytes, bytes + sizeof(Ty));
+	}
+
+	//---- GRAPH ----//
+
+	// False if there is no usable file, the caller then parses the payload
+	bool load_graph(GameData& val, hash_t l0_hash) const
+	{
+		if (directory.empty()) return false;
+
+		const std::string path = graph_path(l0_hash);
+		if (!std::filesystem::exists(path)) return false;
+
+		try
+		{
+			const boost::interprocess::file_mapping mapping(path.c_str(), boost::interprocess::read_only);
+			const boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+
+			const map_cache_format::header& h = check_header(region, map_cache_format::GRAPH, l0_hash, 0);
+
+			const map_cache_format::vertex_record* vertices = reinterpret_cast<const map_cache_format::vertex_record*>(&h + 1);
+			const map_cache_format::edge_record* edges = reinterpret_cast<const map_cache_format::edge_record*>(vertices + h.num_vertices);
+
+			std::shared_ptr<GraphIdx> map_graph = std::make_shared<GraphIdx>();
+			for (uint32_t i = 0; i < h.num_vertices; i++)
+			{
+				map_graph->graph[map_graph->add_vertex(vertices[i].idx)].post_idx = vertices[i].post_idx;
+			}
+
+			for (uint32_t i = 0; i < h.num_edges; i++)
+			{
+				map_graph->graph[map_graph->add_edge(edges[i].idx, edges[i].source, edges[i].target)].length = edges[i].length;
+			}
+
+			val.map_graph = std::move(map_graph);
+
+			LOG_2("map_cache::readJSON_L0: Loaded " << path);
+			return true;
+		}
+		catch (const std::exception& err)
+		{
+			LOG("map_cache: Ignoring " << path << ": " << err.what());
+			return false;
+		}
+	}
+
+	void save_graph(const GameData& val, hash_t l0_hash) const
+	{
+		if (directory.empty()) return;
+
+		const Graph::Graph& g = val.graph();
+
+		map_cache_format::header h = make_header(map_cache_format::GRAPH, l0_hash, 0);
+		h.num_vertices = (uint32_t)boost::num_vertices(g);
+		h.num_edges = (uint32_t)boost::num_edges(g);
+
+		std::vector<char> data;
+		data.reserve(sizeof(h) + h.num_vertices * sizeof(map_cache_format::vertex_record) + h.num_edges * sizeof(map_cache_format::edge_record));
+
+		append(data, h);
+
+		Graph::for_each_vertex_descriptor(g, [&](Graph::vertex_descriptor v) {
+			append(data, map_cache_format::vertex_record{ g[v].idx, g[v].post_idx });
+			});
+
+		Graph::for_each_edge_descriptor(g, [&](Graph::edge_descriptor e) {
+			append(data, map_cache_format::edge_record{ g[e].idx, g[e].length, g[boost::source(e, g)].idx, g[boost::target(e, g)].idx });
+			});
+
+		write_file(graph_path(l0_hash), data);
+	}
+
+	//---- COORDINATES ----//
+
+	bool load_coords(GameData& val, hash_t l0_hash, hash_t l10_hash) const
+	{
+		if (directory.empty()) return false;
+
+		const std::string path = coords_path(l0_hash, l10_hash);
+		if (!std::filesystem::exists(path)) return false;
+
+		try
+		{
+			const boost::interprocess::file_mapping mapping(path.c_str(), boost::interprocess::read_only);
+			const boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+
+			const map_cache_format::header& h = check_header(region, map_cache_format::COORDS, l0_hash, l10_hash);
+			if (h.num_vertices != boost::num_vertices(val.graph())) throw std::runtime_error("Map cache file does not match the graph");
+
+			const map_cache_format::coords_record* points = reinterpret_cast<const map_cache_format::coords_record*>(&h + 1);
+
+			std::shared_ptr<CoordsHolder> map_graph_coords = std::make_shared<CoordsHolder>(val.map_graph->graph);
+
+			uint32_t i = 0;
+			for (CoordsHolder::point_type& point : map_graph_coords->get_vec())
+			{
+				point[0] = points[i].x;
+				point[1] = points[i].y;
+				i++;
+			}
+
+			val.map_graph_coords = std::move(map_graph_coords);
+			val.map_graph_width = h.width;
+			val.map_graph_height = h.height;
+
+			LOG_2("map_cache::readJSON_L10: Loaded " << path);
+			return true;
+		}
+		catch (const std::exception& err)
+		{
+			LOG("map_cache: Ignoring " << path << ": " << err.what());
+			return false;
+		}
+	}
+
+	void save_coords(const GameData& val, hash_t l0_hash, hash_t l10_hash) const
+	{
+		if (directory.empty()) return;
+
+		map_cache_format::header h = make_header(map_cache_format::COORDS, l0_hash, l10_hash);
+		h.num_vertices = (uint32_t)val.map_graph_coords->get_vec().size();
+		h.width = val.map_graph_width;
+		h.height = val.map_graph_height;
+
+		std::vector<char> data;
+		data.reserve(sizeof(h) + h.num_vertices * sizeof(map_cache_format::coords_record));
+
+		append(data, h);
+
+		for (const CoordsHolder::point_type& point : val.map_graph_coords->get_vec())
+		{
+			append(data, map_cache_format::coords_record{ point[0], point[1] });
+		}
+
+		write_file(coords_path(l0_hash, l10_hash), data);
+	}
+};
@@ -0,0 +1,413 @@
+#pragma once
+
+#include <src/game/data.h>
+#include <src/utils/network/server_connector.h>
+
+#include <boost/random/linear_congruential.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+
+struct GameSimulatorConfig
+{
+	// Probability of a random event per owned town per tick, 0 disables it
+	double parasites_chance = 0.0;
+	double hijackers_chance = 0.0;
+	double refugees_chance = 0.0;
+
+	uint8_t max_event_power = 3;
+
+	uint32_t seed = 42;
+};
+
+
+// Local step model of the game rules.
+// Used by the local server to advance its worlds and by the client to predict the next tick.
+class GameSimulator
+{
+public:
+
+	GameSimulator(const GameSimulatorConfig& config = GameSimulatorConfig())
+		: config(config), gen(config.seed) {}
+
+	//------------------------------ HELPERS ------------------------------//
+
+	static Graph::vertex_descriptor train_vertex(const GameData& val, const Trains::Train& train)
+	{
+		const Graph::edge_descriptor e = val.map_graph->emap.at(train.line_idx);
+
+		if (train.position == 0) return boost::source(e, val.graph());
+		if (train.position == val.graph()[e].length) return boost::target(e, val.graph());
+		return val.graph().null_vertex();
+	}
+
+	// Slot of the player's town in GameData::posts.towns, Posts::Towns::NPOS if none
+	static uint32_t find_home_town(const GameData& val, Types::player_id_t player)
+	{
+		if (player == Players::NONE) return Posts::Towns::NPOS;
+
+		return val.posts.towns.find_owned(player);
+	}
+
+	// Places the train on any line connected to the vertex, standing at that vertex
+	static void place_train(GameData& val, Trains::Train& train, Types::vertex_idx_t point_idx)
+	{
+		const Graph::vertex_descriptor v = val.map_graph->vmap.at(point_idx);
+
+		const bool found = Graph::any_of_connected_edge(val.graph(), v, [&](Graph::edge_descriptor e) {
+			train.line_idx = val.graph()[e].idx;
+			train.position = (boost::source(e, val.graph()) == v) ? 0 : val.graph()[e].length;
+			return true;
+			});
+
+		if (!found) throw std::runtime_error("Vertex has no connected lines");
+
+		train.speed = 0;
+	}
+
+	//------------------------------ ACTIONS ------------------------------//
+
+	static bool apply_Move(GameData& val, const server_connector::Move& move)
+	{
+		if (!val.trains.contains(move.train_idx)) return false;
+
+		Trains::Train& train = val.trains[move.train_idx];
+
+		if (train.cooldown > 0) return false;
+		if (move.speed < -1 || move.speed > 1) return false;
+
+		if (move.line_idx == train.line_idx)
+		{
+			train.speed = move.speed;
+			return true;
+		}
+
+		const auto edge_it = val.map_graph->emap.find(move.line_idx);
+		if (edge_it == val.map_graph->emap.end()) return false;
+
+		const Graph::vertex_descriptor v = train_vertex(val, train);
+		if (v == val.graph().null_vertex()) return false;
+
+		const Graph::edge_descriptor e = edge_it->second;
+
+		if (boost::source(e, val.graph()) == v) train.position = 0;
+		else if (boost::target(e, val.graph()) == v) train.position = val.graph()[e].length;
+		else return false;
+
+		train.line_idx = move.line_idx;
+		train.speed = move.speed;
+		return true;
+	}
+
+	static bool apply_Upgrade(GameData& val, const server_connector::Upgrade& upgrade, Types::player_id_t player)
+	{
+		Posts::Towns& towns = val.posts.towns;
+
+		const uint32_t town = find_home_town(val, player);
+		if (town == Posts::Towns::NPOS) return false;
+
+		uint64_t price = 0;
+
+		for (Types::post_idx_t post_idx : upgrade.posts)
+		{
+			if (post_idx != towns.idx[town] || towns.level[town] >= 3) return false;
+			price += Posts::TownTiers[towns.level[town] - 1].next_level_price;
+		}
+
+		for (Types::train_idx_t train_idx : upgrade.trains)
+		{
+			if (!val.trains.contains(train_idx) || val.trains.owner[train_idx] != player) return false;
+
+			const Trains::Train& train = val.trains[train_idx];
+			if (train.level >= 3) return false;
+			price += Trains::TrainTiers[train.level - 1].next_level_price;
+		}
+
+		if (price > towns.armor[town]) return false;
+
+		towns.armor[town] -= price;
+		if (!upgrade.posts.empty()) towns.level[town]++;
+		for (Types::train_idx_t train_idx : upgrade.trains)
+		{
+			val.trains[train_idx].level++;
+		}
+
+		return true;
+	}
+
+	//------------------------------ TICK ------------------------------//
+
+	void step(GameData& val, Types::tick_t tick)
+	{
+		val.events.begin_tick(tick);
+
+		step_posts(val);
+		step_trains(val);
+		step_collisions(val, tick);
+		step_stations(val);
+		step_towns(val, tick);
+		step_random_events(val, tick);
+		step_ratings(val);
+	}
+
+protected:
+
+	static Events::Event make_event(Events::EventType type, Types::tick_t tick)
+	{
+		Events::Event event{};
+		event.type = type;
+		event.tick = tick;
+		return event;
+	}
+
+	static void step_posts(GameData& val)
+	{
+		val.posts.markets.replenish();
+		val.posts.storages.replenish();
+	}
+
+	static void step_trains(GameData& val)
+	{
+		for (Types::train_idx_t train_idx : val.trains.ids)
+		{
+			Trains::Train& train = val.trains[train_idx];
+
+			if (train.cooldown > 0)
+			{
+				train.cooldown--;
+				continue;
+			}
+
+			if (train.speed == 0) continue;
+
+			const Types::edge_length_t length = val.map_graph->get_edge(train.line_idx).length;
+			const int64_t position = (int64_t)train.position + train.speed;
+
+			if (position <= 0)
+			{
+				train.position = 0;
+				train.speed = 0;
+			}
+			else if (position >= length)
+			{
+				train.position = length;
+				train.speed = 0;
+			}
+			else
+			{
+				train.position = position;
+			}
+		}
+	}
+
+	static void step_collisions(GameData& val, Types::tick_t tick)
+	{
+		// Trains collide when they share a vertex or the same point of a line
+		std::map<Types::vertex_idx_t, std::vector<Trains::Train*>> at_vertices;
+		std::map<std::pair<Types::edge_idx_t, Types::edge_length_t>, std::vector<Trains::Train*>> on_lines;
+
+		for (Types::train_idx_t train_idx : val.trains.ids)
+		{
+			Trains::Train* train = &val.trains[train_idx];
+			const Graph::vertex_descriptor v = train_vertex(val, *train);
+
+			if (v != val.graph().null_vertex())
+			{
+				const Graph::VertexProperties& vprops = val.graph()[v];
+				if (val.posts.at_vertex(vprops.idx).type == Posts::TOWN) continue;
+
+				at_vertices[vprops.idx].push_back(train);
+			}
+			else
+			{
+				on_lines[{ train->line_idx, train->position }].push_back(train);
+			}
+		}
+
+		for (auto& [point_idx, trains] : at_vertices)
+		{
+			collide(val, trains, tick);
+		}
+
+		for (auto& [point, trains] : on_lines)
+		{
+			collide(val, trains, tick);
+		}
+	}
+
+	// Crashes every train of the group when there is more than one
+	static void collide(GameData& val, const std::vector<Trains::Train*>& trains, Types::tick_t tick)
+	{
+		if (trains.size() < 2) return;
+
+		for (Trains::Train* train : trains)
+		{
+			for (const Trains::Train* other : trains)
+			{
+				if (other == train) continue;
+
+				Events::Event event = make_event(Events::TRAIN_COLLISION, tick);
+				event.crash.train = other->idx;
+				val.events.add(Events::Subject::TRAIN, train->idx, event);
+			}
+
+			const uint32_t town = find_home_town(val, val.trains.owner[train->idx]);
+
+			train->goods = 0;
+			train->goods_type = Trains::None;
+
+			if (town != Posts::Towns::NPOS)
+			{
+				place_train(val, *train, val.posts.towns.point_idx[town]);
+				train->cooldown = Posts::TownTiers[val.posts.towns.level[town] - 1].cooldown_after_crash;
+			}
+		}
+	}
+
+	static void step_stations(GameData& val)
+	{
+		for (Types::train_idx_t train_idx : val.trains.ids)
+		{
+			Trains::Train& train = val.trains[train_idx];
+			const Graph::vertex_descriptor v = train_vertex(val, train);
+			if (v == val.graph().null_vertex()) continue;
+
+			const Posts::PostRef post = val.posts.at_vertex(val.graph()[v].idx);
+			const uint32_t slot = post.slot;
+			const uint32_t capacity = Trains::TrainTiers[train.level - 1].goods_capacity;
+
+			switch (post.type)
+			{
+			case Posts::MARKET:
+			{
+				if (train.goods_type == Trains::Armor) break;
+
+				uint32_t& product = val.posts.markets.product[slot];
+				const uint32_t amount = std::min(capacity - train.goods, product);
+
+				product -= amount;
+				train.goods += amount;
+				if (train.goods > 0) train.goods_type = Trains::Product;
+			} break;
+			case Posts::STORAGE:
+			{
+				if (train.goods_type == Trains::Product) break;
+
+				uint32_t& armor = val.posts.storages.armor[slot];
+				const uint32_t amount = std::min(capacity - train.goods, armor);
+
+				armor -= amount;
+				train.goods += amount;
+				if (train.goods > 0) train.goods_type = Trains::Armor;
+			} break;
+			case Posts::TOWN:
+			{
+				Posts::Towns& towns = val.posts.towns;
+				if (towns.owner[slot] != val.trains.owner[train_idx]) break;
+
+				const Posts::Town_Tier& tier = Posts::TownTiers[towns.level[slot] - 1];
+
+				if (train.goods_type == Trains::Product)
+				{
+					towns.product[slot] = std::min<uint64_t>(tier.product_capacity, (uint64_t)towns.product[slot] + train.goods);
+				}
+				else if (train.goods_type == Trains::Armor)
+				{
+					towns.armor[slot] = std::min<uint64_t>(tier.armor_capacity, (uint64_t)towns.armor[slot] + train.goods);
+				}
+
+				train.goods = 0;
+				train.goods_type = Trains::None;
+			} break;
+			default: break;
+			}
+		}
+	}
+
+	static void step_towns(GameData& val, Types::tick_t tick)
+	{
+		Posts::Towns& towns = val.posts.towns;
+
+		for (uint32_t town = 0; town < towns.size(); town++)
+		{
+			if (towns.owner[town] == Players::NONE) continue;
+
+			if (towns.product[town] >= towns.population[town])
+			{
+				towns.product[town] -= towns.population[town];
+			}
+			else
+			{
+				towns.product[town] = 0;
+				if (towns.population[town] > 0) towns.population[town]--;
+
+				val.events.add(Events::Subject::POST, towns.idx[town], make_event(Events::RESOURCE_LACK, tick));
+			}
+
+			if (towns.population[town] == 0)
+			{
+				val.events.add(Events::Subject::POST, towns.idx[town], make_event(Events::GAME_OVER, tick));
+			}
+		}
+	}
+
+	void step_random_events(GameData& val, Types::tick_t tick)
+	{
+		boost::random::uniform_real_distribution<double> chance(0.0, 1.0);
+		boost::random::uniform_int_distribution<uint32_t> power(1, config.max_event_power);
+
+		Posts::Towns& towns = val.posts.towns;
+
+		for (uint32_t town = 0; town < towns.size(); town++)
+		{
+			if (towns.owner[town] == Players::NONE) continue;
+
+			if (config.parasites_chance > 0.0 && chance(gen) < config.parasites_chance)
+			{
+				Events::Event event = make_event(Events::PARASITES_ASSAULT, tick);
+				event.assault.power = power(gen);
+				val.events.add(Events::Subject::POST, towns.idx[town], event);
+
+				towns.product[town] -= std::min<uint32_t>(towns.product[town], event.assault.power);
+			}
+
+			if (config.hijackers_chance > 0.0 && chance(gen) < config.hijackers_chance)
+			{
+				Events::Event event = make_event(Events::HIJACKERS_ASSAULT, tick);
+				event.assault.power = power(gen);
+				val.events.add(Events::Subject::POST, towns.idx[town], event);
+
+				towns.armor[town] -= std::min<uint32_t>(towns.armor[town], event.assault.power);
+			}
+
+			if (config.refugees_chance > 0.0 && chance(gen) < config.refugees_chance)
+			{
+				Events::Event event = make_event(Events::REFUGEES_ARRIVAL, tick);
+				event.refugees.number = power(gen);
+				val.events.add(Events::Subject::POST, towns.idx[town], event);
+
+				const uint32_t capacity = Posts::TownTiers[towns.level[town] - 1].population_capacity;
+				towns.population[town] = std::min<uint32_t>(capacity, towns.population[town] + event.refugees.number);
+			}
+		}
+	}
+
+	static void step_ratings(GameData& val)
+	{
+		for (Types::player_id_t player = 0; player < val.players.size(); player++)
+		{
+			const uint32_t town = find_home_town(val, player);
+			if (town == Posts::Towns::NPOS) continue;
+
+			const Posts::Towns& towns = val.posts.towns;
+			val.players[player].rating = towns.population[town] * 1000 + towns.product[town] + towns.armor[town];
+		}
+	}
+
+	GameSimulatorConfig config;
+	boost::minstd_rand gen;
+};
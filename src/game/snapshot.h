@@ -0,0 +1,608 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <src/game/data.h>
+#include <src/game/solver.h>
+
+
+// Binary snapshot of a game: map, coordinates, players, trains, posts, event history and the solver state.
+//
+// File layout (native byte order, packed):
+//   game_snapshot_format::header
+//   game fields, graph, coordinates, players, trains, posts, events, solver checkpoint
+//
+// Variable-length parts are written as a u32 count followed by the items, strings as a u32 length
+// followed by the bytes. Restoring rebuilds the tables in the same slot order, so a restored state
+// compares equal to the saved one.
+namespace game_snapshot_format {
+
+	constexpr char MAGIC[8] = { 'T', '6', 'S', 'N', 'A', 'P', 0, 0 };
+	constexpr uint32_t VERSION = 1;
+
+	struct header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+
+		// Bytes in use including this header
+		uint64_t size;
+
+		// Tick of the event log when the snapshot was taken
+		Types::tick_t tick;
+	};
+}
+
+
+class game_snapshot
+{
+public:
+
+	//------------------------------ SAVE ------------------------------//
+
+	static std::vector<char> encode(const GameData& val, const GameSolver::Checkpoint* checkpoint)
+	{
+		writer out;
+
+		game_snapshot_format::header h;
+		std::memcpy(h.magic, game_snapshot_format::MAGIC, sizeof(h.magic));
+		h.version = game_snapshot_format::VERSION;
+		h.reserved = 0;
+		h.size = 0;
+		h.tick = val.events.tick();
+		out.put(h);
+
+		out.put<uint8_t>(val.game_state);
+		out.put_string(val.player_idx);
+		out.put<uint8_t>(val.player_id);
+		out.put<Types::vertex_idx_t>(val.home_idx);
+		out.put<Types::post_idx_t>(val.post_idx);
+		out.put<uint8_t>(val.in_game);
+
+		encode_graph(out, val);
+		encode_coords(out, val);
+		encode_players(out, val);
+		encode_trains(out, val);
+		encode_posts(out, val);
+		encode_events(out, val);
+		encode_checkpoint(out, checkpoint);
+
+		h.size = out.data.size();
+		std::memcpy(out.data.data(), &h, sizeof(h));
+
+		return std::move(out.data);
+	}
+
+	// Writes through a temporary file, so a reader never sees a partial snapshot
+	static void save(const std::string& path, const GameData& val, const GameSolver::Checkpoint* checkpoint)
+	{
+		const std::vector<char> data = encode(val, checkpoint);
+		const std::string tmp_path = path + ".tmp";
+
+		const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+		if (!parent.empty()) std::filesystem::create_directories(parent);
+
+		{
+			std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) throw std::runtime_error("Failed to create snapshot: " + tmp_path);
+
+			file.write(data.data(), data.size());
+			if (!file) throw std::runtime_error("Failed to write snapshot: " + tmp_path);
+		}
+
+		std::filesystem::rename(tmp_path, path);
+	}
+
+	//------------------------------ RESTORE ------------------------------//
+
+	// Replaces the state with the snapshot. The solver state is only read when checkpoint is given.
+	static void decode(const char* data, size_t size, GameData& val, GameSolver::Checkpoint* checkpoint)
+	{
+		reader in{ data, size };
+
+		const game_snapshot_format::header h = in.get<game_snapshot_format::header>();
+
+		if (std::memcmp(h.magic, game_snapshot_format::MAGIC, sizeof(h.magic)) != 0) throw std::runtime_error("Not a game snapshot");
+		if (h.version != game_snapshot_format::VERSION) throw std::runtime_error("Unsupported game snapshot version " + std::to_string(h.version));
+		if (h.size < sizeof(h) || h.size > size) throw std::runtime_error("Game snapshot is truncated");
+
+		in.size = h.size;
+
+		val.clear();
+
+		val.game_state = (GameData::GameState)in.get<uint8_t>();
+		val.player_idx = in.get_string();
+		val.player_id = in.get<uint8_t>();
+		val.home_idx = in.get<Types::vertex_idx_t>();
+		val.post_idx = in.get<Types::post_idx_t>();
+		val.in_game = in.get<uint8_t>() != 0;
+
+		decode_graph(in, val);
+		decode_coords(in, val);
+		decode_players(in, val);
+		decode_trains(in, val);
+		decode_posts(in, val);
+		decode_events(in, val);
+		decode_checkpoint(in, checkpoint);
+	}
+
+	static void load(const std::string& path, GameData& val, GameSolver::Checkpoint* checkpoint)
+	{
+		LOG_2("game_snapshot::load: Mapping " << path);
+
+		const boost::interprocess::file_mapping mapping(path.c_str(), boost::interprocess::read_only);
+		const boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+
+		decode(static_cast<const char*>(region.get_address()), region.get_size(), val, checkpoint);
+	}
+
+protected:
+
+	struct writer
+	{
+		std::vector<char> data;
+
+		template <class Ty>
+		void put(const Ty& val)
+		{
+			const char* bytes = reinterpret_cast<const char*>(&val);
+			data.insert(data.end(), bytes, bytes + sizeof(Ty));
+		}
+
+		void put_string(const std::string& val)
+		{
+			put<uint32_t>((uint32_t)val.size());
+			data.insert(data.end(), val.begin(), val.end());
+		}
+	};
+
+	struct reader
+	{
+		const char* data;
+		size_t size;
+		size_t offset = 0;
+
+		const char* take(size_t count)
+		{
+			if (size - offset < count) throw std::runtime_error("Game snapshot is truncated");
+
+			const char* ptr = data + offset;
+			offset += count;
+			return ptr;
+		}
+
+		template <class Ty>
+		Ty get()
+		{
+			Ty val;
+			std::memcpy(&val, take(sizeof(Ty)), sizeof(Ty));
+			return val;
+		}
+
+		std::string get_string()
+		{
+			const uint32_t length = get<uint32_t>();
+			return std::string(take(length), length);
+		}
+	};
+
+	//---- GRAPH ----//
+
+	// Vertices in descriptor order and edges in insertion order, so descriptors survive the round trip
+	static void encode_graph(writer& out, const GameData& val)
+	{
+		const Graph::Graph& g = val.graph();
+
+		out.put<uint32_t>((uint32_t)boost::num_vertices(g));
+		Graph::for_each_vertex_descriptor(g, [&](Graph::vertex_descriptor v) {
+			out.put<Types::vertex_idx_t>(g[v].idx);
+			out.put<Types::post_idx_t>(g[v].post_idx);
+			});
+
+		out.put<uint32_t>((uint32_t)boost::num_edges(g));
+		Graph::for_each_edge_descriptor(g, [&](Graph::edge_descriptor e) {
+			out.put<Types::edge_idx_t>(g[e].idx);
+			out.put<Types::edge_length_t>(g[e].length);
+			out.put<Types::vertex_idx_t>(g[boost::source(e, g)].idx);
+			out.put<Types::vertex_idx_t>(g[boost::target(e, g)].idx);
+			});
+	}
+
+	static void decode_graph(reader& in, GameData& val)
+	{
+		std::shared_ptr<GraphIdx> map_graph = std::make_shared<GraphIdx>();
+
+		const uint32_t num_vertices = in.get<uint32_t>();
+		for (uint32_t i = 0; i < num_vertices; i++)
+		{
+			const Graph::vertex_descriptor v = map_graph->add_vertex(in.get<Types::vertex_idx_t>());
+			map_graph->graph[v].post_idx = in.get<Types::post_idx_t>();
+		}
+
+		const uint32_t num_edges = in.get<uint32_t>();
+		for (uint32_t i = 0; i < num_edges; i++)
+		{
+			const Types::edge_idx_t idx = in.get<Types::edge_idx_t>();
+			const Types::edge_length_t length = in.get<Types::edge_length_t>();
+			const Types::vertex_idx_t source = in.get<Types::vertex_idx_t>();
+			const Types::vertex_idx_t target = in.get<Types::vertex_idx_t>();
+
+			map_graph->graph[map_graph->add_edge(idx, source, target)].length = length;
+		}
+
+		val.map_graph = std::move(map_graph);
+	}
+
+	//---- COORDINATES ----//
+
+	static void encode_coords(writer& out, const GameData& val)
+	{
+		out.put<uint8_t>(val.map_graph_coords != nullptr);
+		if (val.map_graph_coords == nullptr) return;
+
+		for (const CoordsHolder::point_type& point : val.map_graph_coords->get_vec())
+		{
+			out.put<double>(point[0]);
+			out.put<double>(point[1]);
+		}
+
+		out.put<Types::position_t>(val.map_graph_width);
+		out.put<Types::position_t>(val.map_graph_height);
+	}
+
+	static void decode_coords(reader& in, GameData& val)
+	{
+		if (in.get<uint8_t>() == 0) return;
+
+		std::shared_ptr<CoordsHolder> map_graph_coords = std::make_shared<CoordsHolder>(val.map_graph->graph);
+
+		for (CoordsHolder::point_type& point : map_graph_coords->get_vec())
+		{
+			point[0] = in.get<double>();
+			point[1] = in.get<double>();
+		}
+
+		val.map_graph_coords = std::move(map_graph_coords);
+		val.map_graph_width = in.get<Types::position_t>();
+		val.map_graph_height = in.get<Types::position_t>();
+	}
+
+	//---- PLAYERS ----//
+
+	// In id order, interning them again gives the same ids
+	static void encode_players(writer& out, const GameData& val)
+	{
+		out.put<uint32_t>((uint32_t)val.players.size());
+		for (const Player& player : val.players)
+		{
+			out.put_string(player.idx);
+			out.put_string(player.name);
+			out.put<int32_t>(player.rating);
+		}
+	}
+
+	static void decode_players(reader& in, GameData& val)
+	{
+		const uint32_t count = in.get<uint32_t>();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Player& player = val.players[val.players.intern(in.get_string())];
+			player.name = in.get_string();
+			player.rating = in.get<int32_t>();
+		}
+	}
+
+	//---- TRAINS ----//
+
+	static void encode_trains(writer& out, const GameData& val)
+	{
+		out.put<uint32_t>((uint32_t)val.trains.size());
+		for (Types::train_idx_t train_idx : val.trains.ids)
+		{
+			const Trains::Train& train = val.trains[train_idx];
+
+			out.put<Types::train_idx_t>(train_idx);
+			out.put<Types::player_id_t>(val.trains.owner[train_idx]);
+			out.put<uint8_t>(train.level);
+			out.put<Types::tick_t>(train.cooldown);
+			out.put<uint32_t>(train.goods);
+			out.put<uint8_t>(train.goods_type);
+			out.put<Types::edge_idx_t>(train.line_idx);
+			out.put<Types::edge_length_t>(train.position);
+			out.put<int8_t>(train.speed);
+		}
+	}
+
+	static void decode_trains(reader& in, GameData& val)
+	{
+		const uint32_t count = in.get<uint32_t>();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Types::train_idx_t train_idx = in.get<Types::train_idx_t>();
+			Trains::Train& train = val.trains.add(train_idx, in.get<Types::player_id_t>());
+
+			train.level = in.get<uint8_t>();
+			train.cooldown = in.get<Types::tick_t>();
+			train.goods = in.get<uint32_t>();
+			train.goods_type = (Trains::GoodsType)in.get<uint8_t>();
+			train.line_idx = in.get<Types::edge_idx_t>();
+			train.position = in.get<Types::edge_length_t>();
+			train.speed = in.get<int8_t>();
+		}
+	}
+
+	//---- POSTS ----//
+
+	// Table by table in slot order, so the restored posts land in the same slots
+	static void encode_posts(writer& out, const GameData& val)
+	{
+		const Posts::PostTables& posts = val.posts;
+
+		const Posts::Towns& towns = posts.towns;
+		out.put<uint32_t>(towns.size());
+		for (uint32_t slot = 0; slot < towns.size(); slot++)
+		{
+			encode_post_row(out, towns, slot);
+			out.put<uint32_t>(towns.armor[slot]);
+			out.put<uint8_t>(towns.level[slot]);
+			out.put<Types::player_id_t>(towns.owner[slot]);
+			out.put<uint32_t>(towns.population[slot]);
+			out.put<uint32_t>(towns.product[slot]);
+			out.put<Types::tick_t>(towns.train_cooldown[slot]);
+		}
+
+		const Posts::Markets& markets = posts.markets;
+		out.put<uint32_t>(markets.size());
+		for (uint32_t slot = 0; slot < markets.size(); slot++)
+		{
+			encode_post_row(out, markets, slot);
+			out.put<uint32_t>(markets.product[slot]);
+			out.put<uint32_t>(markets.product_capacity[slot]);
+			out.put<uint32_t>(markets.replenishment[slot]);
+		}
+
+		const Posts::Storages& storages = posts.storages;
+		out.put<uint32_t>(storages.size());
+		for (uint32_t slot = 0; slot < storages.size(); slot++)
+		{
+			encode_post_row(out, storages, slot);
+			out.put<uint32_t>(storages.armor[slot]);
+			out.put<uint32_t>(storages.armor_capacity[slot]);
+			out.put<uint32_t>(storages.replenishment[slot]);
+		}
+	}
+
+	static void encode_post_row(writer& out, const Posts::PostColumns& columns, uint32_t slot)
+	{
+		out.put<Types::post_idx_t>(columns.idx[slot]);
+		out.put<Types::vertex_idx_t>(columns.point_idx[slot]);
+		out.put_string(columns.name[slot]);
+	}
+
+	static uint32_t decode_post_row(reader& in, GameData& val, Posts::PostType type)
+	{
+		const Types::post_idx_t post_idx = in.get<Types::post_idx_t>();
+		const Types::vertex_idx_t point_idx = in.get<Types::vertex_idx_t>();
+
+		const Posts::PostRef ref = val.posts.add(type, post_idx, point_idx);
+		val.posts.columns(type).name[ref.slot] = in.get_string();
+
+		return ref.slot;
+	}
+
+	static void decode_posts(reader& in, GameData& val)
+	{
+		Posts::Towns& towns = val.posts.towns;
+		const uint32_t num_towns = in.get<uint32_t>();
+		for (uint32_t i = 0; i < num_towns; i++)
+		{
+			const uint32_t slot = decode_post_row(in, val, Posts::TOWN);
+			towns.armor[slot] = in.get<uint32_t>();
+			towns.level[slot] = in.get<uint8_t>();
+			towns.owner[slot] = in.get<Types::player_id_t>();
+			towns.population[slot] = in.get<uint32_t>();
+			towns.product[slot] = in.get<uint32_t>();
+			towns.train_cooldown[slot] = in.get<Types::tick_t>();
+		}
+
+		Posts::Markets& markets = val.posts.markets;
+		const uint32_t num_markets = in.get<uint32_t>();
+		for (uint32_t i = 0; i < num_markets; i++)
+		{
+			const uint32_t slot = decode_post_row(in, val, Posts::MARKET);
+			markets.product[slot] = in.get<uint32_t>();
+			markets.product_capacity[slot] = in.get<uint32_t>();
+			markets.replenishment[slot] = in.get<uint32_t>();
+		}
+
+		Posts::Storages& storages = val.posts.storages;
+		const uint32_t num_storages = in.get<uint32_t>();
+		for (uint32_t i = 0; i < num_storages; i++)
+		{
+			const uint32_t slot = decode_post_row(in, val, Posts::STORAGE);
+			storages.armor[slot] = in.get<uint32_t>();
+			storages.armor_capacity[slot] = in.get<uint32_t>();
+			storages.replenishment[slot] = in.get<uint32_t>();
+		}
+	}
+
+	//---- EVENTS ----//
+
+	// Retained entries oldest first, restored by logging them again on their own ticks
+	static void encode_events(writer& out, const GameData& val)
+	{
+		out.put<uint32_t>((uint32_t)val.events.size());
+		val.events.for_each_since(INT64_MIN, [&](const Events::EventLog::Entry& entry) {
+			out.put<Types::tick_t>(entry.logged);
+			out.put<uint8_t>((uint8_t)entry.subject);
+			out.put<uint32_t>(entry.subject_idx);
+			out.put<Events::Event>(entry.event);
+			});
+
+		out.put<Types::tick_t>(val.events.tick());
+	}
+
+	static void decode_events(reader& in, GameData& val)
+	{
+		const uint32_t count = in.get<uint32_t>();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			val.events.begin_tick(in.get<Types::tick_t>());
+
+			const Events::Subject subject = (Events::Subject)in.get<uint8_t>();
+			const uint32_t subject_idx = in.get<uint32_t>();
+			val.events.add(subject, subject_idx, in.get<Events::Event>());
+		}
+
+		val.events.begin_tick(in.get<Types::tick_t>());
+	}
+
+	//---- SOLVER ----//
+
+	static void encode_checkpoint(writer& out, const GameSolver::Checkpoint* checkpoint)
+	{
+		out.put<uint8_t>(checkpoint != nullptr);
+		if (checkpoint == nullptr) return;
+
+		out.put<Types::tick_t>(checkpoint->tick);
+		out.put<uint64_t>(checkpoint->food_epoch4_ts_idx);
+
+		out.put<uint32_t>((uint32_t)checkpoint->exclude_edges.size());
+		for (const GraphDijkstra::weightmap_transform_t& edges : checkpoint->exclude_edges)
+		{
+			out.put<uint32_t>((uint32_t)edges.size());
+			for (Types::edge_idx_t edge_idx : edges) out.put<Types::edge_idx_t>(edge_idx);
+		}
+	}
+
+	static void decode_checkpoint(reader& in, GameSolver::Checkpoint* checkpoint)
+	{
+		if (in.get<uint8_t>() == 0)
+		{
+			if (checkpoint != nullptr) throw std::runtime_error("Game snapshot has no solver state");
+			return;
+		}
+
+		GameSolver::Checkpoint val;
+		val.tick = in.get<Types::tick_t>();
+		val.food_epoch4_ts_idx = (size_t)in.get<uint64_t>();
+
+		val.exclude_edges.resize(in.get<uint32_t>());
+		for (GraphDijkstra::weightmap_transform_t& edges : val.exclude_edges)
+		{
+			const uint32_t count = in.get<uint32_t>();
+			for (uint32_t i = 0; i < count; i++) edges.insert(in.get<Types::edge_idx_t>());
+		}
+
+		if (checkpoint != nullptr) *checkpoint = std::move(val);
+	}
+};
+
+
+// Saves snapshots on a background thread, started with the first snapshot. The state is copied on
+// the calling thread, which is all the game loop pays; a snapshot requested while the previous one
+// is still being written is skipped.
+class game_snapshot_writer
+{
+public:
+
+	game_snapshot_writer() = default;
+
+	~game_snapshot_writer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		cv.notify_one();
+
+		if (worker.joinable()) worker.join();
+	}
+
+	game_snapshot_writer(const game_snapshot_writer&) = delete;
+	game_snapshot_writer& operator=(const game_snapshot_writer&) = delete;
+
+	// False if the previous snapshot is still being written
+	bool save(const std::string& path, const GameData& val, const GameSolver::Checkpoint* checkpoint = nullptr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (busy) return false;
+
+			// The writer does not touch the state until it is requested
+			busy = true;
+		}
+
+		GameData::copy_state(state, val);
+
+		has_checkpoint = checkpoint != nullptr;
+		if (has_checkpoint) this->checkpoint = *checkpoint;
+
+		this->path = path;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requested = true;
+		}
+		cv.notify_one();
+
+		if (!worker.joinable()) worker = std::thread(&game_snapshot_writer::run, this);
+
+		return true;
+	}
+
+protected:
+
+	void run()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [this]() { return stopping || requested; });
+
+				if (!requested) return;
+			}
+
+			try
+			{
+				game_snapshot::save(path, state, has_checkpoint ? &checkpoint : nullptr);
+			}
+			catch (const std::exception& err)
+			{
+				LOG("game_snapshot_writer: Failed to save " << path << ": " << err.what());
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			requested = false;
+			busy = false;
+		}
+	}
+
+	// Owned by the writer while busy
+	GameData state;
+	GameSolver::Checkpoint checkpoint;
+	bool has_checkpoint = false;
+	std::string path;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool busy = false;
+	bool requested = false;
+	bool stopping = false;
+
+	std::thread worker;
+};
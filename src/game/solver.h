@@ -2,56 +2,264 @@
 
 #include <src/game/solver/train.h>
 #include <src/game/solver/collisions_checker.h>
+#include <src/game/solver/plan_view.h>
 #include <src/utils/network/server_connector.h>
+#include <src/utils/tick_arena.h>
+#include <src/utils/alloc_stats.h>
+#include <src/utils/metrics.h>
+
+#include <unordered_map>
 
 
 class GameSolver
 {
 public:
 
+	// Phase times and allocations of every calculate_plan are recorded here when set
+	metrics_registry* metrics = nullptr;
+
 	GameSolver(const GameData& gamedata, server_connector& connector)
 		: gamedata(gamedata), 
 		connector(connector), 
 		pathsolver(gamedata),
 		tick(0)
 	{
-		for (const auto& [train_idx, train_data] : gamedata.self_data().trains)
+		// TrainSolvers are referenced by their PathSolvers and must not be relocated
+		trainsolvers.reserve(gamedata.trains.size());
+
+		gamedata.trains.for_each_owned(gamedata.player_id, [&](const Trains::Train& train) {
+			trainsolvers.emplace_back(gamedata, train.idx, deltas_market, deltas_storage, &arena);
+			});
+	}
+
+	void reset_deltas()
+	{
+		reset_delta(deltas_market);
+		reset_delta(deltas_storage);
+	}
+
+	// Zeroes the map in place once it has the size of the graph
+	void reset_delta(GraphVertexMap<double>& deltas)
+	{
+		if (deltas.get_vec().size() == boost::num_vertices(gamedata.graph()))
+		{
+			std::fill(deltas.get_vec().begin(), deltas.get_vec().end(), 0.0);
+		}
+		else
 		{
-			trainsolvers.emplace_back(gamedata, train_idx, deltas_market, deltas_storage);
+			deltas.init(gamedata.graph());
 		}
 	}
 
-	void reset_deltas()
+	// Requests decided for one turn
+	struct Plan
+	{
+		std::vector<server_connector::Upgrade> upgrades;
+		std::vector<server_connector::Move> moves;
+	};
+
+	// Solver state carried between turns, to roll back a discarded calculation
+	struct Checkpoint
+	{
+		Types::tick_t tick;
+		size_t food_epoch4_ts_idx;
+		std::vector<GraphDijkstra::weightmap_transform_t> exclude_edges;
+	};
+
+	Checkpoint checkpoint() const
+	{
+		Checkpoint val{ tick, food_epoch4_ts_idx };
+
+		for (const TrainSolver& ts : trainsolvers)
+		{
+			val.exclude_edges.push_back(ts.pathsolver.exclude_edges);
+		}
+
+		return val;
+	}
+
+	void rollback(const Checkpoint& val)
+	{
+		tick = val.tick;
+		food_epoch4_ts_idx = val.food_epoch4_ts_idx;
+
+		for (size_t i = 0; i < trainsolvers.size(); ++i)
+		{
+			trainsolvers[i].pathsolver.exclude_edges = val.exclude_edges[i];
+		}
+	}
+
+	// Carries on from a checkpoint of an earlier run, false if it was taken with other trains
+	bool restore(const Checkpoint& val)
 	{
-		deltas_market.init(gamedata.graph());
-		deltas_storage.init(gamedata.graph());
+		if (val.exclude_edges.size() != trainsolvers.size()) return false;
+
+		rollback(val);
+		return true;
+	}
+
+	// Marks the trains the update moved, the others keep their distances from the last tick.
+	// A list that does not follow the last one applied marks every train.
+	void apply_changes(const Changes::ChangeList& val)
+	{
+		const bool continuous = val.continues(changes_seq);
+		changes_seq = val.seq;
+
+		for (TrainSolver& ts : trainsolvers)
+		{
+			ts.pathsolver.track_moves = true;
+			if (!continuous) ts.pathsolver.moved = true;
+		}
+
+		if (!continuous) return;
+
+		val.for_each(Changes::TRAIN_MOVED, [&](const Changes::Change& change) {
+			const size_t idx = getTrainSolverIndex(change.idx);
+			if (idx < trainsolvers.size()) trainsolvers[idx].pathsolver.moved = true;
+			});
 	}
 
 	void calculate()
 	{
+		send_plan(calculate_plan());
+	}
+
+	// Decides the turn without sending anything
+	Plan calculate_plan()
+	{
+		const metrics_registry::scoped_timer total_timer(metrics, metrics_registry::SOLVER_TOTAL);
+		const uint64_t heap_allocations = alloc_stats::allocations();
+
+		// Moves of the last tick are the only objects left in the arena
+		for (TrainSolver& train_solver : trainsolvers)
+		{
+			train_solver.possible_move.reset();
+		}
+		arena.reset();
+
 		tick++;
 
+		plan = Plan();
+
 		reset_deltas();
 
-		calculate_upgrades();
+		{
+			const metrics_registry::scoped_timer timer(metrics, metrics_registry::SOLVER_UPGRADES);
+			calculate_upgrades();
+		}
 
-		calculate_states();
+		{
+			const metrics_registry::scoped_timer timer(metrics, metrics_registry::SOLVER_STATES);
+			calculate_states();
+		}
 
-		for (auto& train_solver : trainsolvers)
 		{
-			train_solver.calculate_Turn();
+			const metrics_registry::scoped_timer timer(metrics, metrics_registry::SOLVER_TURNS);
+
+			for (auto& train_solver : trainsolvers)
+			{
+				train_solver.calculate_Turn();
+			}
 		}
 
-		CollisionsChecker::check_and_solve(trainsolvers, gamedata);
+		{
+			const metrics_registry::scoped_timer timer(metrics, metrics_registry::SOLVER_COLLISIONS);
+			CollisionsChecker::check_and_solve(trainsolvers, gamedata);
+		}
 
 		for (auto& train_solver : trainsolvers) {
 
 			if (train_solver.possible_move.has_value())
 			{
-				connector.async_send_Move(get<2>(train_solver.possible_move.value()));
+				plan.moves.push_back(get<2>(train_solver.possible_move.value()));
+			}
+		}
+
+		LOG_3("GameSolver::calculate_plan: Tick " << tick << ": arena " << arena.allocations() << " allocations, " << arena.bytes() << " bytes, "
+			<< arena.upstream_allocations() << " past the buffer; heap " << (alloc_stats::allocations() - heap_allocations) << " allocations");
+
+		if (metrics != nullptr) metrics->record(metrics_registry::TICK_ALLOCATIONS, alloc_stats::allocations() - heap_allocations);
+
+		return plan;
+	}
+
+	void send_plan(const Plan& val)
+	{
+		for (const server_connector::Upgrade& upgrade : val.upgrades)
+		{
+			connector.send_Upgrade(upgrade);
+		}
+
+		for (const server_connector::Move& move : val.moves)
+		{
+			connector.send_Move(move);
+		}
+	}
+
+	// Routes of the last calculate_plan and the edge occupancy they predict over the next horizon ticks.
+	// Only reads the solver, so it is called on the solver thread and the view handed to others.
+	void describe_plan(PlanView& view, uint32_t horizon)
+	{
+		view.clear(gamedata.events.tick(), horizon);
+		occupancy_index.clear();
+
+		const Graph::Graph& graph = gamedata.graph();
+
+		// Adds the ticks a train spends on the edge, within what is left of the horizon
+		const auto occupy = [&](Graph::edge_descriptor e, Types::edge_length_t distance, uint32_t& elapsed) {
+			if (elapsed >= horizon) return;
+
+			const uint32_t ticks = std::min<uint32_t>((uint32_t)distance, horizon - elapsed);
+			elapsed += ticks;
+			if (ticks == 0) return;
+
+			const auto [it, inserted] = occupancy_index.try_emplace(graph[e].idx, view.occupancy.size());
+			if (inserted) view.occupancy.push_back({ e, 0 });
+			view.occupancy[it->second].train_ticks += ticks;
+		};
+
+		for (const TrainSolver& ts : trainsolvers)
+		{
+			if (!ts.possible_move.has_value()) continue;
+
+			const Trains::Train& train = ts.gamedata_train();
+			const auto& [path, path_edges, move, target] = ts.possible_move.value();
+
+			PlanView::Route& route = view.add_route();
+			route.train_idx = train.idx;
+			route.line_idx = train.line_idx;
+			route.position = train.position;
+			route.vertices.assign(path.begin(), path.end());
+			route.vertices.push_back(target);
+
+			// First to the end of the current line the path starts at, then along the path
+			const Graph::edge_descriptor line = gamedata.map_graph->emap.at(train.line_idx);
+			const Types::edge_length_t to_start = route.vertices.front() == boost::source(line, graph) ? train.position : graph[line].length - train.position;
+
+			uint32_t elapsed = 0;
+			occupy(line, to_start, elapsed);
+
+			for (const Graph::edge_descriptor e : path_edges)
+			{
+				occupy(e, graph[e].length, elapsed);
 			}
 		}
 
+		// Trains of the other players keep going the way they go
+		for (Types::train_idx_t train_idx : gamedata.trains.ids)
+		{
+			if (gamedata.trains.owner[train_idx] == gamedata.player_id) continue;
+
+			const Trains::Train& train = gamedata.trains[train_idx];
+			const Graph::edge_descriptor line = gamedata.map_graph->emap.at(train.line_idx);
+
+			Types::edge_length_t distance = graph[line].length;
+			if (train.speed > 0) distance = graph[line].length - train.position;
+			else if (train.speed < 0) distance = train.position;
+
+			uint32_t elapsed = 0;
+			occupy(line, train.speed == 0 ? horizon : distance, elapsed);
+		}
 	}
 
 	void calculate_states() {
@@ -59,7 +267,7 @@ public:
 		if (epoch <= 3)  // 0,1,2,3
 		{
 			for (TrainSolver& ts : trainsolvers) {
-				if (ts.gamedata_train.goods_type == Trains::Armor && ts.gamedata_train.goods > 35) {
+				if (ts.gamedata_train().goods_type == Trains::Armor && ts.gamedata_train().goods > 35) {
 					ts.state = TrainSolver::State::RETURN;
 				}
 				ts.state = TrainSolver::State::NORMAL_ARMOR;
@@ -72,7 +280,7 @@ public:
 
 				TrainSolver& ts = trainsolvers[food_epoch4_ts_idx];						   //1 train collexts food
 
-				if (ts.gamedata_train.goods_type == Trains::Product && ts.gamedata_train.goods > 0) {
+				if (ts.gamedata_train().goods_type == Trains::Product && ts.gamedata_train().goods > 0) {
 					ts.state = TrainSolver::State::RETURN;
 				}
 
@@ -83,7 +291,7 @@ public:
 				if (i != food_epoch4_ts_idx)
 				{
 					TrainSolver& ts = trainsolvers[i];
-					if (ts.gamedata_train.goods_type == Trains::Armor && ts.gamedata_train.goods > 35)
+					if (ts.gamedata_train().goods_type == Trains::Armor && ts.gamedata_train().goods > 35)
 					{
 						ts.state = TrainSolver::State::RETURN;
 					}
@@ -94,7 +302,7 @@ public:
 		}
 		else { //epoch 5,6,7 (partly 8) - collect food 
 			for (TrainSolver& ts : trainsolvers) {
-				if (ts.gamedata_train.goods != 0)		//train has already visited market for food
+				if (ts.gamedata_train().goods != 0)		//train has already visited market for food
 					ts.state = TrainSolver::State::RETURN;
 				else
 					ts.state = TrainSolver::State::NORMAL_FOOD;
@@ -103,9 +311,10 @@ public:
 	}
 
 	void calculate_upgrades() {
-		const Posts::Town* town = get_home_town();
-		if (town != nullptr) {
-			auto armour = town->armor;
+		const Posts::PostRef town = get_home_town();
+		if (town.type == Posts::TOWN) {
+			const uint8_t town_level = gamedata.posts.towns.level[town.slot];
+			auto armour = gamedata.posts.towns.armor[town.slot];
 
 			bool updated = true;
 			while (updated) {
@@ -114,8 +323,8 @@ public:
 
 				for (size_t i = 0; i < trainsolvers.size(); ++i) {
 
-					if (trainsolvers[i].gamedata_train.level < min_level) {
-						min_level = trainsolvers[i].gamedata_train.level;
+					if (trainsolvers[i].gamedata_train().level < min_level) {
+						min_level = trainsolvers[i].gamedata_train().level;
 						min_train_index = i;
 					}
 				}
@@ -124,34 +333,34 @@ public:
 				//check for train updates
 				if (min_level == 1 && armour >= Trains::TrainTiers[0].next_level_price) {
 					armour -= Trains::TrainTiers[0].next_level_price;
-					connector.async_send_Upgrade({ {},{min_train_index} });
+					plan.upgrades.push_back({ {},{trainsolvers[min_train_index].train_idx} });
 
 					updated = true;
 				}
 				else if (min_level == 2 && armour >= Trains::TrainTiers[1].next_level_price) {
 					armour -= Trains::TrainTiers[1].next_level_price;
-					connector.async_send_Upgrade({ {},{min_train_index} });
+					plan.upgrades.push_back({ {},{trainsolvers[min_train_index].train_idx} });
 					updated = true;
 				}
-				else if (town->level == 2 && armour >= 75) {  //check for city updates
+				else if (town_level == 2 && armour >= 75) {  //check for city updates
 					armour -= 75;
-					connector.async_send_Upgrade({ {gamedata.home_idx},{} });
+					plan.upgrades.push_back({ {gamedata.post_idx},{} });
 					updated = true;
 				}
-				else if (town->level == 2 && armour >= 185) {
+				else if (town_level == 2 && armour >= 185) {
 					armour -= 150;
-					connector.async_send_Upgrade({ {gamedata.home_idx},{} });
+					plan.upgrades.push_back({ {gamedata.post_idx},{} });
 					updated = true;
 				}
 			}
 		}
 		else {
-			std::cout << "nullptr while getting home town";
+			std::cout << "no home town while calculating upgrades";
 		}
 
 	}
-	const Posts::Town* get_home_town() {
-		return (const Posts::Town*) gamedata.posts.at(gamedata.post_idx).get();
+	Posts::PostRef get_home_town() {
+		return gamedata.posts.find(gamedata.post_idx);
 	}
 
 	Types::Epoch get_epoch() {
@@ -160,7 +369,7 @@ public:
 
 	size_t getTrainSolverIndex(Types::train_idx_t t) {
 		for (size_t i = 0; i < trainsolvers.size(); ++i) {
-			if (trainsolvers[i].gamedata_train.idx == t)
+			if (trainsolvers[i].gamedata_train().idx == t)
 				return i;
 		}
 		return std::numeric_limits<uint32_t>::max();
@@ -180,15 +389,15 @@ public:
 
 	bool is_at_home(TrainSolver& ts) {
 		auto v_idx = gamedata.home_idx;
-		auto v = gamedata.map_graph.vmap.at(v_idx);
-		for (auto& p : gamedata.map_graph.emap) {
-			if (ts.gamedata_train.line_idx == p.first) {
+		auto v = gamedata.map_graph->vmap.at(v_idx);
+		for (auto& p : gamedata.map_graph->emap) {
+			if (ts.gamedata_train().line_idx == p.first) {
 				auto e = p.second;
-				auto u = boost::source(e, gamedata.map_graph.graph);
-				auto t = boost::target(e, gamedata.map_graph.graph);
+				auto u = boost::source(e, gamedata.map_graph->graph);
+				auto t = boost::target(e, gamedata.map_graph->graph);
 				if (
-					(v == u && ts.gamedata_train.position == 0)||
-					(v == t && ts.gamedata_train.position == (gamedata.map_graph.graph[e].length - 1))
+					(v == u && ts.gamedata_train().position == 0)||
+					(v == t && ts.gamedata_train().position == (gamedata.map_graph->graph[e].length - 1))
 					)
 				{
 					return true;
@@ -203,13 +412,22 @@ protected:
 	const GameData& gamedata;
 	server_connector& connector;
 
+	// Transient objects of one calculate_plan, reset at its start
+	tick_arena arena;
+
 	std::vector<TrainSolver> trainsolvers;
 
 	GraphVertexMap<double> deltas_market;
 	GraphVertexMap<double> deltas_storage;
 
 	PathSolver pathsolver;
+
+	// Edge idx to its entry in PlanView::occupancy, scratch of describe_plan
+	std::unordered_map<Types::edge_idx_t, size_t> occupancy_index;
 	
 	Types::tick_t tick;
-	size_t food_epoch4_ts_idx;
+	uint64_t changes_seq = 0;
+	size_t food_epoch4_ts_idx = std::numeric_limits<uint32_t>::max();
+
+	Plan plan;
 };
@@ -2,20 +2,24 @@
 
 #include <src/game/solver/train.h>
 #include <vector>
+#include <memory_resource>
 
 class CollisionsChecker {
 
 
 	static bool solve_towards_collision(TrainSolver& t1, TrainSolver& t2, const GameData& gamedata) {
 
-		std::vector<Graph::edge_descriptor> for_delete;
-
 		auto& tuple1 = t1.possible_move.value();
 		auto& tuple2 = t2.possible_move.value();
 
 		auto& path1 = std::get<0>(tuple1);
 		auto& path2 = std::get<0>(tuple2);
 
+		// Same tick arena as the paths
+		std::pmr::vector<Graph::edge_descriptor> for_delete(path1.get_allocator());
+
+		if (path1.empty() || path2.empty()) return false;
+
 		for (size_t i = 0; i < path1.size() - 1; ++i) {
 			for (size_t j = 0; j < path2.size() - 1; ++j) {
 				if (path1[i] == path2[j + 1] && path1[i + 1] == path2[j]) {
@@ -42,7 +46,7 @@ class CollisionsChecker {
 
 	static void check_and_solve(TrainSolver& t1, TrainSolver& t2, const GameData& gamedata) {
 		if (t1.possible_move.has_value() && t2.possible_move.has_value()) {
-			const GraphIdx& g = gamedata.map_graph;
+			const GraphIdx& g = *gamedata.map_graph;
 
 			auto& tuple1 = t1.possible_move.value();
 			auto& tuple2 = t2.possible_move.value();
@@ -63,8 +67,8 @@ class CollisionsChecker {
 
 				return;
 			}
-			auto l1 = t1.gamedata_train.line_idx;
-			auto l2 = t2.gamedata_train.line_idx;
+			auto l1 = t1.gamedata_train().line_idx;
+			auto l2 = t2.gamedata_train().line_idx;
 
 			auto move_l1 = move1.line_idx;
 			auto move_l2 = move2.line_idx;
@@ -94,9 +98,9 @@ class CollisionsChecker {
 						position2 = g.graph[g.emap.at(move_l2)].length - 1;
 				}
 				if (position1 == UINT32_MAX)
-					position1 = t1.gamedata_train.position;
+					position1 = t1.gamedata_train().position;
 				if (position2 == UINT32_MAX)
-					position2 = t2.gamedata_train.position;
+					position2 = t2.gamedata_train().position;
 
 				if (position1 + move1.speed == position2 + move2.speed) {
 					if (move2.speed == 0) {
@@ -110,22 +114,22 @@ class CollisionsChecker {
 			else { //  
 				Graph::vertex_descriptor v1 = UINT32_MAX, v2 = UINT32_MAX;
 
-				if (t2.gamedata_train.position == 0 && move1.speed == 0)
+				if (t2.gamedata_train().position == 0 && move1.speed == 0)
 					v1 = boost::source(g.emap.at(l1), g.graph);
-				if (t2.gamedata_train.position == 1 && move1.speed == -1)
+				if (t2.gamedata_train().position == 1 && move1.speed == -1)
 					v1 = boost::source(g.emap.at(l1), g.graph);
-				if (t2.gamedata_train.position == g.graph[g.emap.at(l1)].length - 1 && move1.speed == 0)
+				if (t2.gamedata_train().position == g.graph[g.emap.at(l1)].length - 1 && move1.speed == 0)
 					v1 = boost::target(g.emap.at(l1), g.graph);
-				if (t2.gamedata_train.position == g.graph[g.emap.at(l1)].length - 2 && move1.speed == 1)
+				if (t2.gamedata_train().position == g.graph[g.emap.at(l1)].length - 2 && move1.speed == 1)
 					v1 = boost::target(g.emap.at(l1), g.graph);
 
-				if (t2.gamedata_train.position == 0 && move2.speed == 0)
+				if (t2.gamedata_train().position == 0 && move2.speed == 0)
 					v2 = boost::source(g.emap.at(l2), g.graph);
-				if (t2.gamedata_train.position == 1 && move2.speed == -1)
+				if (t2.gamedata_train().position == 1 && move2.speed == -1)
 					v2 = boost::source(g.emap.at(l2), g.graph);
-				if (t2.gamedata_train.position == g.graph[g.emap.at(l2)].length - 1 && move2.speed == 0)
+				if (t2.gamedata_train().position == g.graph[g.emap.at(l2)].length - 1 && move2.speed == 0)
 					v2 = boost::target(g.emap.at(l2), g.graph);
-				if (t2.gamedata_train.position == g.graph[g.emap.at(l2)].length - 2 && move2.speed == 1)
+				if (t2.gamedata_train().position == g.graph[g.emap.at(l2)].length - 2 && move2.speed == 1)
 					v2 = boost::target(g.emap.at(l2), g.graph);
 
 				if (v1 != UINT32_MAX && v1 == v2) {
@@ -142,7 +146,7 @@ class CollisionsChecker {
 public:
 	static void check_and_solve(std::vector<TrainSolver>& trainsolvers, const GameData& gamedata) {
 		for (size_t i = 0; i < trainsolvers.size(); ++i) {
-			for (size_t j = 0; j < trainsolvers.size(); ++j) {
+			for (size_t j = i + 1; j < trainsolvers.size(); ++j) {
 				check_and_solve(trainsolvers[i], trainsolvers[j], gamedata);
 			}
 		}
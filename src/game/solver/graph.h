@@ -11,6 +11,7 @@
 #include <vector>
 #include <deque>
 #include <set>
+#include <memory_resource>
 
 class GraphDijkstra
 {
@@ -23,7 +24,7 @@ public:
 
 	using index_map_t = boost::property_map<Graph::Graph, boost::vertex_index_t>::type;
 
-	GraphDijkstra(const Graph::Graph& graph, const std::set<Types::edge_idx_t>& weighmap_transform)
+	GraphDijkstra(const Graph::Graph& graph, const std::set<Types::edge_idx_t>& weightmap_transform)
 		: graph_(graph), 
 		weightmap_transform(weightmap_transform),
 		vbegin(graph.null_vertex()),
@@ -31,7 +32,8 @@ public:
 		predecessors_vec(boost::num_vertices(graph)),
 		predecessors(predecessors_vec.begin(), boost::get(boost::vertex_index, graph)),
 		distances_vec(boost::num_vertices(graph)),
-		distances(distances_vec.begin(), boost::get(boost::vertex_index, graph))
+		distances(distances_vec.begin(), boost::get(boost::vertex_index, graph)),
+		colors_vec(boost::num_vertices(graph))
 	{
 		
 	}
@@ -45,8 +47,9 @@ public:
 			v,
 			boost::predecessor_map(predecessors)
 			.distance_map(distances)
+			.color_map(boost::make_iterator_property_map(colors_vec.begin(), boost::get(boost::vertex_index, graph_)))
 			.weight_map(boost::make_transform_value_property_map([&](const Graph::EdgeProperties& edge) { 
-				return (weightmap_transform.find(edge.idx) == weightmap_transform.end() ? INFINITY : edge.length);
+				return (weightmap_transform.find(edge.idx) != weightmap_transform.end() ? INFINITY : edge.length);
 				}, get(boost::edge_bundle, graph_)))
 			);
 	}
@@ -77,11 +80,12 @@ public:
 			});
 	}
 
-	using path_t = std::deque<Graph::vertex_descriptor>;
+	// Paths only live for one tick, so they take the solver's tick arena, see tick_arena
+	using path_t = std::pmr::deque<Graph::vertex_descriptor>;
 
-	path_t calculate_path(Graph::vertex_descriptor vend) const
+	path_t calculate_path(Graph::vertex_descriptor vend, std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const
 	{
-		path_t path;
+		path_t path(mem);
 		for (Graph::vertex_descriptor cur = vend;
 			cur != graph_.null_vertex() 
 			&& predecessors[cur] != cur 
@@ -93,11 +97,11 @@ public:
 		return path;
 	}
 
-	using path_edges_t = std::deque<Graph::edge_descriptor>;
+	using path_edges_t = std::pmr::deque<Graph::edge_descriptor>;
 
-	path_edges_t calculate_path_edges(Graph::vertex_descriptor vend) const
+	path_edges_t calculate_path_edges(Graph::vertex_descriptor vend, std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const
 	{
-		path_edges_t path;
+		path_edges_t path(mem);
 		for (Graph::vertex_descriptor cur = vend;
 			cur != graph_.null_vertex()
 			&& cur != vbegin;)
@@ -125,4 +129,7 @@ public:
 	GraphVertexMap<double>::PositionVec distances_vec;
 	GraphVertexMap<double>::PositionMap distances;
 
+	// Reused by every run instead of a color map allocated by dijkstra_shortest_paths
+	std::vector<boost::default_color_type> colors_vec;
+
 };
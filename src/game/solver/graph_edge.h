@@ -49,15 +49,15 @@ public:
 		else return t;
 	}
 
-	GraphDijkstra::path_t get_path(Graph::vertex_descriptor vend) const
+	GraphDijkstra::path_t get_path(Graph::vertex_descriptor vend, std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const
 	{
-		if (get_is_source(vend)) return s.calculate_path(vend);
-		else return t.calculate_path(vend);
+		if (get_is_source(vend)) return s.calculate_path(vend, mem);
+		else return t.calculate_path(vend, mem);
 	}
 
-	GraphDijkstra::path_edges_t get_path_edges(Graph::vertex_descriptor vend) const
+	GraphDijkstra::path_edges_t get_path_edges(Graph::vertex_descriptor vend, std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const
 	{
-		if (get_is_source(vend)) return s.calculate_path_edges(vend);
-		else return t.calculate_path_edges(vend);
+		if (get_is_source(vend)) return s.calculate_path_edges(vend, mem);
+		else return t.calculate_path_edges(vend, mem);
 	}
 };
@@ -11,8 +11,10 @@ class PathSolver
 {
 public:
 
-	PathSolver(const GameData& gamedata)
+	// Paths of calculate_Move are allocated from mem
+	PathSolver(const GameData& gamedata, std::pmr::memory_resource* mem = std::pmr::get_default_resource())
 		: gamedata(gamedata),
+		mem(mem),
 		graphsolver(gamedata.graph(), exclude_edges)
 	{
 	}
@@ -20,15 +22,24 @@ public:
 	void init(Graph::edge_descriptor epos, Types::edge_length_t pos)
 	{
 		graphsolver.calculate(epos, pos);
+
+		// Not necessarily where the train is, the next init of the train has to calculate again
+		moved = true;
 	}
 
+	// Keeps the distances of the last call while the train has not moved, see track_moves
 	void init(Types::train_idx_t train_idx)
 	{
-		const Trains::Train& train_data = gamedata.self_data().trains.at(train_idx);
-		Graph::edge_descriptor epos = gamedata.map_graph.emap.at(train_data.line_idx);
+		if (track_moves && !moved && exclude_edges == solved_exclude_edges) return;
+
+		const Trains::Train& train_data = gamedata.trains.at(train_idx);
+		Graph::edge_descriptor epos = gamedata.map_graph->emap.at(train_data.line_idx);
 		Types::edge_length_t pos = train_data.position;
 
 		init(epos, pos);
+
+		moved = false;
+		solved_exclude_edges = exclude_edges;
 	}
 
 	Types::edge_length_t distance_to(Graph::vertex_descriptor target) const
@@ -43,11 +54,11 @@ public:
 
 		
 		bool solver_is_source = graphsolver.get_is_source(target);
-		GraphDijkstra::path_edges_t solver_path_edges = graphsolver.get_path_edges(target);
-		GraphDijkstra::path_t solver_path = graphsolver.get_path(target);
+		GraphDijkstra::path_edges_t solver_path_edges = graphsolver.get_path_edges(target, mem);
+		GraphDijkstra::path_t solver_path = graphsolver.get_path(target, mem);
 
-		const Trains::Train& train_data = gamedata.self_data().trains.at(train_idx);
-		Graph::edge_descriptor epos = gamedata.map_graph.emap.at(train_data.line_idx);
+		const Trains::Train& train_data = gamedata.trains.at(train_idx);
+		Graph::edge_descriptor epos = gamedata.map_graph->emap.at(train_data.line_idx);
 		Types::edge_length_t pos = train_data.position;
 
 		if (solver_is_source == false)
@@ -60,16 +71,16 @@ public:
 
 				if (Graph::isSource(gamedata.graph(), v, solver_path.front()))
 				{
-					return std::make_tuple(solver_path, solver_path_edges, server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, 1, train_idx }, target);
+					return std::make_tuple(std::move(solver_path), std::move(solver_path_edges), server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, 1, train_idx }, target);
 				}
 				else
 				{
-					return std::make_tuple(solver_path, solver_path_edges, server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, -1, train_idx }, target);
+					return std::make_tuple(std::move(solver_path), std::move(solver_path_edges), server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, -1, train_idx }, target);
 				}
 			}
 			else
 			{
-				return std::make_tuple(solver_path, solver_path_edges, server_connector::Move{ gamedata.graph()[epos].idx, -1, train_idx }, target);
+				return std::make_tuple(std::move(solver_path), std::move(solver_path_edges), server_connector::Move{ gamedata.graph()[epos].idx, -1, train_idx }, target);
 			}
 		}
 		else
@@ -83,24 +94,24 @@ public:
 
 				if (Graph::isSource(gamedata.graph(), v, solver_path.front()))
 				{
-					return std::make_tuple(solver_path, solver_path_edges, server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, 1, train_idx }, target);
+					return std::make_tuple(std::move(solver_path), std::move(solver_path_edges), server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, 1, train_idx }, target);
 				}
 				else
 				{
-					return std::make_tuple(solver_path, solver_path_edges, server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, -1, train_idx }, target);
+					return std::make_tuple(std::move(solver_path), std::move(solver_path_edges), server_connector::Move{ gamedata.graph()[solver_path_edges.front()].idx, -1, train_idx }, target);
 				}
 			}
 			else
 			{
-				return std::make_tuple(solver_path, solver_path_edges, server_connector::Move{ gamedata.graph()[epos].idx, 1, train_idx }, target);
+				return std::make_tuple(std::move(solver_path), std::move(solver_path_edges), server_connector::Move{ gamedata.graph()[epos].idx, 1, train_idx }, target);
 			}
 		}
 	}
 
 	/*bool is_train_nearby(Types::train_idx_t train_idx, Types::edge_length_t dist) const
 	{
-		const Trains::Train& train_data = gamedata.self_data().trains.at(train_idx);
-		const Graph::EdgeProperties& train_edge = gamedata.map_graph.get_edge(train_data.line_idx);
+		const Trains::Train& train_data = gamedata.trains.at(train_idx);
+		const Graph::EdgeProperties& train_edge = gamedata.map_graph->get_edge(train_data.line_idx);
 
 		if (train_data.position <= dist)
 		{
@@ -112,7 +123,7 @@ public:
 
 	bool is_train_at_vertex(Types::train_idx_t train_idx, Graph::vertex_descriptor vertex) const
 	{
-		const Trains::Train& train_data = gamedata.self_data().trains.at(train_idx);
+		const Trains::Train& train_data = gamedata.trains.at(train_idx);
 		const Types::position_t train_pos = train_data.position;
 
 		if (train_pos == 0)
@@ -132,8 +143,17 @@ public:
 protected:
 
 	const GameData& gamedata;
+	std::pmr::memory_resource* mem;
 
 public:
 	GraphDijkstra::weightmap_transform_t exclude_edges;
 	GraphEdgeDijkstra graphsolver;
+
+	// Set by an owner that reports every move of the train through moved, see GameSolver::apply_changes.
+	// Without it the distances are calculated on every init.
+	bool track_moves = false;
+	bool moved = true;
+
+protected:
+	GraphDijkstra::weightmap_transform_t solved_exclude_edges;
 };
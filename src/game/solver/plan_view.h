@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include <src/game/data.h>
+
+
+// What the solver intends after a calculate_plan, copied out of the solver for other threads.
+//
+// Routes follow possible_move of every own train. Occupancy is the predicted number of train-ticks
+// on each edge over the next horizon ticks: own trains move along their routes one length unit per
+// tick, the other trains keep going on their current line. Vectors keep their capacity when a
+// view is filled again, see GameSolver::describe_plan.
+struct PlanView
+{
+	struct Route
+	{
+		Types::train_idx_t train_idx;
+
+		// Where the train is now
+		Types::edge_idx_t line_idx;
+		Types::edge_length_t position;
+
+		// Vertices the train passes, the target last
+		std::vector<Graph::vertex_descriptor> vertices;
+	};
+
+	struct Occupancy
+	{
+		Graph::edge_descriptor edge;
+		uint32_t train_ticks;
+	};
+
+	Types::tick_t tick = 0;
+	uint32_t horizon = 0;
+
+	size_t num_routes = 0;
+	std::vector<Route> routes;
+
+	std::vector<Occupancy> occupancy;
+
+	// Starts filling the view of the next plan
+	void clear(Types::tick_t tick, uint32_t horizon)
+	{
+		this->tick = tick;
+		this->horizon = horizon;
+
+		num_routes = 0;
+		occupancy.clear();
+	}
+
+	Route& add_route()
+	{
+		if (num_routes == routes.size()) routes.emplace_back();
+
+		Route& route = routes[num_routes++];
+		route.vertices.clear();
+		return route;
+	}
+};
@@ -22,11 +22,10 @@ public:
 		STANDBY
 	};
 
-	TrainSolver(const GameData& gamedata, Types::train_idx_t train_idx, GraphVertexMap<double>& deltas_market, GraphVertexMap<double>& deltas_storage, State state = State::STANDBY)
+	TrainSolver(const GameData& gamedata, Types::train_idx_t train_idx, GraphVertexMap<double>& deltas_market, GraphVertexMap<double>& deltas_storage, std::pmr::memory_resource* mem, State state = State::STANDBY)
 		: gamedata(gamedata),
-		pathsolver(gamedata),
-		train_idx(train_idx), gamedata_train(gamedata.self_data().trains.at(train_idx)),
-		train_data(gamedata.self_data().trains.at(train_idx)),
+		pathsolver(gamedata, mem),
+		train_idx(train_idx),
 		deltas_market(deltas_market),
 		deltas_storage(deltas_storage),
 		state(state)
@@ -37,7 +36,7 @@ protected:
 
 	Graph::edge_descriptor get_edge() const
 	{
-		return gamedata.map_graph.emap.at(train_data.line_idx);
+		return gamedata.map_graph->emap.at(train_data().line_idx);
 	}
 
 	const Graph::EdgeProperties& get_edge_props() const
@@ -58,26 +57,26 @@ public:
 			Types::edge_length_t vdist = pathsolver.distance_to(v);
 			if (vdist == 0) return;
 
-			if (gamedata.graph()[v].post_idx != UINT32_MAX)
-				if (gamedata.posts.at(gamedata.graph()[v].post_idx)->type() == Posts::MARKET)
+			const Posts::PostRef post = gamedata.posts.at_vertex(gamedata.graph()[v].idx);
+			if (post.type == Posts::MARKET)
+			{
+				const Posts::Markets& markets = gamedata.posts.markets;
+
+				double value = std::min<double>({
+					(double)Trains::TrainTiers[train_data().level - 1].goods_capacity - train_data().goods,
+					(double)markets.product_capacity[post.slot],
+					(double)markets.product[post.slot] + markets.replenishment[post.slot] * vdist - deltas_market[v]
+					}) / vdist;
+
+				if (value > target_value)
 				{
-					const Posts::Market* market = (const Posts::Market*) gamedata.posts.at(gamedata.graph()[v].post_idx).get();
-
-					double value = std::min<double>({
-						(double)Trains::TrainTiers[train_data.level].goods_capacity - train_data.goods,
-						(double)market->product_capacity,
-						(double)market->product + market->replenishment * vdist - deltas_market[v]
-						}) / vdist;
-
-					if (value > target_value)
-					{
-						target = v;
-						target_value = value;
-					}
+					target = v;
+					target_value = value;
 				}
+			}
 			});
 
-		deltas_market[target] += target_value;
+		if (target != gamedata.graph().null_vertex()) deltas_market[target] += target_value;
 		return target;
 	}
 
@@ -92,27 +91,27 @@ public:
 			Types::edge_length_t vdist = pathsolver.distance_to(v);
 			if (vdist == 0) return;
 
-			if (gamedata.graph()[v].post_idx != UINT32_MAX)
-				if (gamedata.posts.at(gamedata.graph()[v].post_idx)->type() == Posts::STORAGE)
+			const Posts::PostRef post = gamedata.posts.at_vertex(gamedata.graph()[v].idx);
+			if (post.type == Posts::STORAGE)
+			{
+				const Posts::Storages& storages = gamedata.posts.storages;
+
+				double value = std::min<double>({
+					(double)Trains::TrainTiers[train_data().level - 1].goods_capacity - train_data().goods,
+					(double)storages.armor_capacity[post.slot],
+					(double)storages.armor[post.slot] + storages.replenishment[post.slot] * vdist - deltas_storage[v]
+					}) / vdist;
+
+				if (value > target_value)
 				{
-					const Posts::Storage* storage = (const Posts::Storage*)gamedata.posts.at(gamedata.graph()[v].post_idx).get();
-
-					double value = std::min<double>({
-						(double)Trains::TrainTiers[train_data.level].goods_capacity - train_data.goods,
-						(double)storage->armor_capacity,
-						(double)storage->armor + storage->replenishment * vdist - deltas_storage[v]
-						}) / vdist;
-
-					if (value > target_value)
-					{
-						target = v;
-						target_value = value;
-					}
+					target = v;
+					target_value = value;
 				}
+			}
 			
 			});
 
-		deltas_storage[target] += target_value;
+		if (target != gamedata.graph().null_vertex()) deltas_storage[target] += target_value;
 		return target;
 	}
 
@@ -126,13 +125,11 @@ public:
 		Graph::for_each_vertex_descriptor(gamedata.graph(), [&](Graph::vertex_descriptor v) {
 			Types::edge_length_t vdist = pathsolver.distance_to(v);
 
-			if (gamedata.graph()[v].post_idx != UINT32_MAX)
-				if (gamedata.posts.at(gamedata.graph()[v].post_idx)->type() == Posts::MARKET)
-					if (vdist < target_dist)
-					{
-						target = v;
-						target_dist = vdist;
-					}
+			if (gamedata.posts.at_vertex(gamedata.graph()[v].idx).type == Posts::MARKET && vdist < target_dist)
+			{
+				target = v;
+				target_dist = vdist;
+			}
 			});
 
 		return target;
@@ -148,13 +145,11 @@ public:
 		Graph::for_each_vertex_descriptor(gamedata.graph(), [&](Graph::vertex_descriptor v) {
 			Types::edge_length_t vdist = pathsolver.distance_to(v);
 
-			if (gamedata.graph()[v].post_idx != UINT32_MAX)
-				if (gamedata.posts.at(gamedata.graph()[v].post_idx)->type() == Posts::STORAGE)
-					if (vdist < target_dist)
-					{
-						target = v;
-						target_dist = vdist;
-					}
+			if (gamedata.posts.at_vertex(gamedata.graph()[v].idx).type == Posts::STORAGE && vdist < target_dist)
+			{
+				target = v;
+				target_dist = vdist;
+			}
 			});
 
 		return target;
@@ -178,13 +173,13 @@ public:
 	{
 		Graph::vertex_descriptor target = choose_target();
 
-		if (train_data.cooldown > 0)
+		if (train_data().cooldown > 0)
 		{
 			possible_move = std::nullopt;
 			return;
 		}
 
-		possible_move = pathsolver.calculate_Move(train_data.idx, target);
+		possible_move = pathsolver.calculate_Move(train_data().idx, target);
 	}
 
 
@@ -193,7 +188,10 @@ public:
 private:
 	
 	
-	const Trains::Train& train_data;
+	const Trains::Train& train_data() const
+	{
+		return gamedata.trains[train_idx];
+	}
 
 	GraphVertexMap<double>& deltas_market;
 	GraphVertexMap<double>& deltas_storage;
@@ -203,7 +201,11 @@ private:
 public:
 	const Types::train_idx_t train_idx;
 
-	const Trains::Train& gamedata_train;
+	// Looked up on every access, rows of the train table may move when trains are added
+	const Trains::Train& gamedata_train() const
+	{
+		return gamedata.trains[train_idx];
+	}
 
 	PathSolver pathsolver;
 
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <future>
+#include <memory>
+
+#include <src/game/solver.h>
+#include <src/game/simulator.h>
+#include <src/utils/thread_pool.h>
+
+
+// Overlaps the solver with the Turn round trip.
+//
+// Once a turn is sent, the next tick is predicted with the local step model and solved in the
+// background. When the real L1 arrives the prediction is validated: on a match the plan is sent
+// right away, otherwise the solver is rolled back and runs again on the real state.
+class GameSpeculator
+{
+public:
+
+	GameSpeculator(const GameData& gamedata, server_connector& connector, thread_pool* pool = nullptr, metrics_registry* metrics = nullptr)
+		: gamedata(gamedata), connector(connector), pool(pool)
+	{
+		GameData::copy_state(predicted, gamedata);
+
+		// The solver only ever looks at the predicted copy, the real state is parsed meanwhile
+		solver = std::make_unique<GameSolver>(predicted, connector);
+		solver->metrics = metrics;
+	}
+
+	~GameSpeculator()
+	{
+		if (pending.valid()) pending.wait();
+	}
+
+	// Solves the current real state without speculation
+	void calculate()
+	{
+		GameData::copy_state(predicted, gamedata);
+
+		plan = solver->calculate_plan();
+		solver->send_plan(plan);
+	}
+
+	// Call after the plan is sent and before the Turn: starts solving the predicted next tick
+	void speculate()
+	{
+		GameData::copy_state(predicted, gamedata);
+
+		for (const server_connector::Upgrade& upgrade : plan.upgrades)
+		{
+			GameSimulator::apply_Upgrade(predicted, upgrade, predicted.player_id);
+		}
+
+		for (const server_connector::Move& move : plan.moves)
+		{
+			GameSimulator::apply_Move(predicted, move);
+		}
+
+		tick = predicted.events.tick() + 1;
+		simulator.step(predicted, tick);
+
+		speculation_checkpoint = solver->checkpoint();
+
+		if (pool != nullptr)
+		{
+			pending = pool->submit([this]() { return solver->calculate_plan(); });
+		}
+		else
+		{
+			pending = std::async(std::launch::async, [this]() { return solver->calculate_plan(); });
+		}
+	}
+
+	// Call once the real L1 is parsed: sends the speculative plan if the prediction holds
+	void commit()
+	{
+		plan = pending.get();
+
+		if (matches(predicted, gamedata))
+		{
+			hits++;
+		}
+		else
+		{
+			misses++;
+			LOG_2("GameSpeculator::commit: Misprediction on tick " << tick << ", solving again");
+
+			solver->rollback(speculation_checkpoint);
+
+			GameData::copy_state(predicted, gamedata);
+			plan = solver->calculate_plan();
+		}
+
+		solver->send_plan(plan);
+	}
+
+	// Solver state after the plan sent last, only while no speculation runs
+	GameSolver::Checkpoint checkpoint() const
+	{
+		return solver->checkpoint();
+	}
+
+	bool restore(const GameSolver::Checkpoint& val)
+	{
+		return solver->restore(val);
+	}
+
+	// Routes of the plan sent last, only while no speculation runs: after calculate() or commit()
+	void describe_plan(PlanView& view, uint32_t horizon)
+	{
+		solver->describe_plan(view, horizon);
+	}
+
+	// Compares everything the solver reads: own trains and all posts.
+	// Other players' trains are ignored, their moves are unknown until the L1 arrives anyway.
+	static bool matches(const GameData& predicted, const GameData& real)
+	{
+		for (Types::train_idx_t train_idx : real.trains.ids)
+		{
+			if (real.trains.owner[train_idx] != real.player_id) continue;
+			if (!predicted.trains.contains(train_idx)) return false;
+
+			const Trains::Train& p = predicted.trains[train_idx];
+			const Trains::Train& train = real.trains[train_idx];
+			if (p.line_idx != train.line_idx || p.position != train.position || p.speed != train.speed
+				|| p.cooldown != train.cooldown || p.level != train.level
+				|| p.goods != train.goods || p.goods_type != train.goods_type) return false;
+		}
+
+		// Same slots on both sides, so the mutable columns compare as whole arrays
+		const Posts::PostTables& p = predicted.posts;
+		const Posts::PostTables& r = real.posts;
+
+		return p.same_layout(r)
+			&& p.towns.armor == r.towns.armor && p.towns.product == r.towns.product
+			&& p.towns.population == r.towns.population && p.towns.level == r.towns.level
+			&& p.markets.product == r.markets.product
+			&& p.storages.armor == r.storages.armor;
+	}
+
+	size_t hits = 0;
+	size_t misses = 0;
+
+protected:
+
+	const GameData& gamedata;
+	server_connector& connector;
+	thread_pool* pool;
+
+	GameData predicted;
+	GameSimulator simulator;
+	std::unique_ptr<GameSolver> solver;
+
+	GameSolver::Plan plan;
+	GameSolver::Checkpoint speculation_checkpoint;
+	std::future<GameSolver::Plan> pending;
+
+	Types::tick_t tick = 0;
+};
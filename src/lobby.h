@@ -20,7 +20,8 @@ public:
 	Lobby(boost::asio::io_service& io)
 		: connector(io)
 	{
-
+		// Round trips for the HUD of the game window
+		connector.stats = &stats;
 	}
 
 	~Lobby()
@@ -231,6 +232,7 @@ public:
 
 
 protected:
+	network_stats stats;
 	server_connector connector;
 
 	std::vector<LobbyData> lobbies;
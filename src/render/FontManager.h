@@ -0,0 +1,22 @@
+#pragma once
+#include <src/render/ResourceManager.h>
+#include "SFML/Graphics.hpp"
+
+class FontManager :
+	public ResourceManager<FontManager, sf::Font>
+{
+public:
+	FontManager(const std::string& path) : ResourceManager(path) {}
+
+	sf::Font* Load(const std::string& l_path) {
+		sf::Font* font = new sf::Font();
+		if (!font->loadFromFile(l_path))
+		{
+			delete font;
+			font = nullptr;
+			std::cerr << "! Failed to load font: "
+				<< l_path << std::endl;
+		}
+		return font;
+	}
+};
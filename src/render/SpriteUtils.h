@@ -2,6 +2,9 @@
 
 #include <SFML/Graphics.hpp>
 
+#include <cmath>
+#include <algorithm>
+
 namespace VectorUtils {
 
 	inline sf::Vector2f makeVector2f(const sf::Vector2u& vec)
@@ -14,6 +17,11 @@ namespace VectorUtils {
 		return sf::Vector2u(vec.x, vec.y);
 	}
 
+	inline float length(const sf::Vector2f& vec)
+	{
+		return std::sqrt(vec.x * vec.x + vec.y * vec.y);
+	}
+
 } // namespace VectorUtils
 
 namespace TextureUtils {
@@ -70,3 +78,78 @@ namespace SpriteUtils {
 	}
 
 } // SpriteUtils
+
+namespace QuadUtils {
+
+	// Writes the 4 vertices of a quad: local_rect moved by transform, showing tex_rect of the texture
+	inline void set(sf::Vertex* quad, const sf::Transform& transform, const sf::FloatRect& local_rect, const sf::FloatRect& tex_rect)
+	{
+		const float right = local_rect.left + local_rect.width;
+		const float bottom = local_rect.top + local_rect.height;
+
+		quad[0].position = transform.transformPoint(sf::Vector2f(local_rect.left, local_rect.top));
+		quad[1].position = transform.transformPoint(sf::Vector2f(right, local_rect.top));
+		quad[2].position = transform.transformPoint(sf::Vector2f(right, bottom));
+		quad[3].position = transform.transformPoint(sf::Vector2f(local_rect.left, bottom));
+
+		quad[0].texCoords = sf::Vector2f(tex_rect.left, tex_rect.top);
+		quad[1].texCoords = sf::Vector2f(tex_rect.left + tex_rect.width, tex_rect.top);
+		quad[2].texCoords = sf::Vector2f(tex_rect.left + tex_rect.width, tex_rect.top + tex_rect.height);
+		quad[3].texCoords = sf::Vector2f(tex_rect.left, tex_rect.top + tex_rect.height);
+	}
+
+	// Same as a sprite of the whole region drawn with transform
+	inline void set(sf::Vertex* quad, const sf::Transform& transform, const sf::IntRect& region)
+	{
+		set(quad, transform, sf::FloatRect(0.f, 0.f, (float)region.width, (float)region.height), sf::FloatRect(region));
+	}
+
+	inline void append(sf::VertexArray& vertices, const sf::Transform& transform, const sf::IntRect& region)
+	{
+		const size_t offset = vertices.getVertexCount();
+		vertices.resize(offset + 4);
+		set(&vertices[offset], transform, region);
+	}
+
+	// Appends a quad of the given width from a to b, untextured
+	inline void append_line(sf::VertexArray& vertices, const sf::Vector2f& a, const sf::Vector2f& b, float width, const sf::Color& color)
+	{
+		const sf::Vector2f direction = b - a;
+		const float length = VectorUtils::length(direction);
+		if (length == 0.f) return;
+
+		const sf::Vector2f normal = sf::Vector2f(-direction.y, direction.x) * (width / 2.f / length);
+
+		vertices.append(sf::Vertex(a + normal, color));
+		vertices.append(sf::Vertex(b + normal, color));
+		vertices.append(sf::Vertex(b - normal, color));
+		vertices.append(sf::Vertex(a - normal, color));
+	}
+
+	// Axis-aligned bounds of the quad, what sf::Sprite::getGlobalBounds gives for a sprite
+	inline sf::FloatRect bounds(const sf::Vertex* quad)
+	{
+		float left = quad[0].position.x, top = quad[0].position.y, right = left, bottom = top;
+
+		for (size_t i = 1; i < 4; i++)
+		{
+			left = std::min(left, quad[i].position.x);
+			top = std::min(top, quad[i].position.y);
+			right = std::max(right, quad[i].position.x);
+			bottom = std::max(bottom, quad[i].position.y);
+		}
+
+		return sf::FloatRect(left, top, right - left, bottom - top);
+	}
+
+	// Transform of a sprite of the given texture size, centered on position and scaled to size
+	inline sf::Transform centered(const sf::Vector2f& position, const sf::Vector2f& size, const sf::IntRect& region)
+	{
+		sf::Transformable t;
+		t.setOrigin(region.width / 2.f, region.height / 2.f);
+		t.setScale(size.x / region.width, size.y / region.height);
+		t.setPosition(position);
+		return t.getTransform();
+	}
+
+} // QuadUtils
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <condition_variable>
+
+#include <src/render/game_drawer.h>
+
+
+// Offscreen rendering of selected ticks to PNG files, for looking at a game without a live window.
+//
+// capture() only copies the state into a queue; a background thread owns the GL context, draws the
+// queued states into an sf::RenderTexture with the usual layers and writes <directory>/tick_<N>.png.
+// When the writer falls behind, new frames are dropped instead of stalling the game loop.
+class frame_capture
+{
+public:
+
+	// Every interval-th tick is captured
+	frame_capture(const std::string& directory, uint32_t interval, const game_drawer_config& config, size_t max_pending = 4)
+		: directory(directory), interval(std::max<uint32_t>(interval, 1)), config(config), max_pending(max_pending)
+	{
+		std::filesystem::create_directories(directory);
+
+		worker = std::thread(&frame_capture::run, this);
+	}
+
+	~frame_capture()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		cv.notify_one();
+
+		worker.join();
+
+		if (num_dropped > 0) LOG("frame_capture: Dropped " << num_dropped << " frame(s), the writer was behind");
+	}
+
+	frame_capture(const frame_capture&) = delete;
+	frame_capture& operator=(const frame_capture&) = delete;
+
+	// Queues the state if its tick is selected, false if it was not queued
+	bool capture(const GameData& val)
+	{
+		if (val.events.tick() % interval != 0) return false;
+
+		std::unique_ptr<GameData> frame;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (queue.size() >= max_pending)
+			{
+				num_dropped++;
+				return false;
+			}
+
+			if (!spare.empty())
+			{
+				frame = std::move(spare.back());
+				spare.pop_back();
+			}
+		}
+
+		if (frame == nullptr) frame = std::make_unique<GameData>();
+		GameData::copy_state(*frame, val);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(frame));
+		}
+		cv.notify_one();
+
+		return true;
+	}
+
+	size_t dropped() const
+	{
+		return num_dropped;
+	}
+
+protected:
+
+	void run()
+	{
+		try
+		{
+			// The GL context of the texture and the atlas belongs to this thread
+			texture_atlas atlas(config.atlas_paths);
+			atlas.build();
+
+			FontManager fonts(config.fonts_paths);
+
+			game_drawer_config frame_config = config;
+			frame_config.atlas = &atlas;
+			frame_config.fonts = &fonts;
+
+			// Every frame shows its tick as it is
+			frame_config.animate_trains = false;
+
+			sf::RenderTexture target;
+			if (!target.create(frame_config.window_videomode.width, frame_config.window_videomode.height))
+			{
+				throw std::runtime_error("Failed to create the capture texture");
+			}
+
+			std::unique_ptr<game_drawer> drawer;
+
+			while (true)
+			{
+				std::unique_ptr<GameData> frame;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+					if (queue.empty()) return;
+
+					frame = std::move(queue.front());
+					queue.pop_front();
+				}
+
+				if (drawer == nullptr)
+				{
+					drawer = std::make_unique<game_drawer>(*frame, frame_config);
+					drawer->init(*frame);
+				}
+				else
+				{
+					drawer->apply(*frame);
+				}
+
+				target.clear(frame_config.clear_color);
+				drawer->draw(target, *frame, frame_config);
+				target.display();
+
+				const std::string path = frame_path(frame->events.tick());
+				if (!target.getTexture().copyToImage().saveToFile(path)) LOG("frame_capture: Failed to write " << path);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				spare.push_back(std::move(frame));
+			}
+		}
+		catch (const std::exception& err)
+		{
+			LOG("frame_capture: Stopped: " << err.what());
+		}
+	}
+
+	std::string frame_path(Types::tick_t tick) const
+	{
+		std::stringstream ss;
+		ss << "tick_" << std::setw(6) << std::setfill('0') << tick << ".png";
+		return (std::filesystem::path(directory) / ss.str()).string();
+	}
+
+	const std::string directory;
+	const uint32_t interval;
+	const game_drawer_config config;
+	const size_t max_pending;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+
+	std::deque<std::unique_ptr<GameData>> queue;
+	std::vector<std::unique_ptr<GameData>> spare;
+	size_t num_dropped = 0;
+
+	std::thread worker;
+};
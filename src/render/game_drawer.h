@@ -4,16 +4,31 @@
 #include <SFML/Window.hpp>
 
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
 #include <boost/thread.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 
 #include <map>
+#include <sstream>
+#include <iomanip>
 #include <functional>
 
 #include <src/game/data.h>
-#include <src/render/TextureManager.h>
+#include <src/game/solver/plan_view.h>
+#include <src/utils/triple_buffer.h>
+#include <src/render/texture_atlas.h>
+#include <src/render/FontManager.h>
+#include <src/render/render_scheduler.h>
 #include <src/render/SpriteUtils.h>
+#include <src/render/spatial_grid.h>
+#include <src/render/tile_cache.h>
 
 #include <src/utils/value_map.h>
+#include <src/utils/metrics.h>
+#include <src/utils/alloc_stats.h>
 #include <src/utils/Math.h>
 #include <src/utils/MinMax.h>
 
@@ -24,20 +39,80 @@ struct game_drawer_config
 	sf::VideoMode window_videomode;
 	std::string window_name;
 
-	std::string edge_length_font;
+	// Paths file of the fonts, see FontManager
+	std::string fonts_paths;
 
 	ValueMap<float> padding_width = ValueMap<float>(0, 1, 0, 1);
 	ValueMap<float> padding_height = ValueMap<float>(0, 1, 0, 1);
 
-	float frame_time = 1.0f / 10.0f;
+	// Minimum time between two frames, caps the frame rate
+	float frame_time = 1.0f / 60.0f;
 
-	TextureManager* textures = nullptr;
+	// Longest the render thread sleeps without polling window events
+	float input_poll_time = 1.0f / 30.0f;
+
+	// Below this many pixels per layout unit the layers draw points and lines instead of sprites and text
+	float detail_scale = 0.5f;
+
+	// Trains glide to their new positions over a tick instead of jumping, see game_drawer_layer::trains
+	bool animate_trains = true;
+
+	// Camera zoom limits, in pixels per layout unit
+	float min_zoom = 1.0f / 8.0f;
+	float max_zoom = 16.0f;
+
+	// Paths file of the atlas textures, see texture_atlas
+	std::string atlas_paths;
+
+	// Built on the render thread, see game_drawer_thread
+	texture_atlas* atlas = nullptr;
+
+	// Fonts are loaded on first use and shared by the layers
+	FontManager* fonts = nullptr;
+
+	// Read by the HUD while it is shown, frame times are recorded into it, may stay null
+	metrics_registry* metrics = nullptr;
+};
+
+// Where the game is drawn: a live window, nowhere, or PNG files of selected ticks, see frame_capture
+enum class render_mode : uint8_t
+{
+	WINDOW,
+	HEADLESS,
+	CAPTURE,
 };
 
 
 
 namespace game_drawer_layer {
 
+	// Layout coordinates of a point at position along the line
+	inline sf::Vector2f line_point(Types::edge_idx_t line_idx, Types::edge_length_t position, const GameData& gamedata, const game_drawer_config& config)
+	{
+		const auto& edge = gamedata.map_graph->emap.at(line_idx);
+		auto u = boost::source(edge, gamedata.map_graph->graph);
+		auto v = boost::target(edge, gamedata.map_graph->graph);
+
+		const auto& coords = gamedata.map_graph_coords->get_map();
+
+		double v_x_distance = config.padding_width.map(coords[u][0]) - config.padding_width.map(coords[v][0]);
+		double v_y_distance = config.padding_height.map(coords[u][1]) - config.padding_height.map(coords[v][1]);
+
+		double edge_length = gamedata.map_graph->graph[edge].length;
+		float koeff = (float)position / edge_length;
+
+		return sf::Vector2f(
+			config.padding_width.map(coords[u][0]) + (float)v_x_distance * koeff,
+			config.padding_height.map(coords[u][1]) + (float)v_y_distance * koeff
+		);
+	}
+
+	inline sf::Vector2f vertex_point(Graph::vertex_descriptor v, const GameData& gamedata, const game_drawer_config& config)
+	{
+		const CoordsHolder::point_type& vcoords = gamedata.map_graph_coords->get_map()[v];
+		return sf::Vector2f(config.padding_width.map(vcoords[0]), config.padding_height.map(vcoords[1]));
+	}
+
 
 	class layer_base
 	{
@@ -47,9 +122,60 @@ namespace game_drawer_layer {
 
 		virtual void init(const GameData& gamedata, const game_drawer_config& config) = 0;
 		virtual void reset() = 0;
-		virtual void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config) = 0;
+		virtual void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config) = 0;
+
+		// Static layers only change in init, game_drawer renders them once into a texture
+		virtual bool is_static() const
+		{
+			return false;
+		}
+
+		// Called once per new snapshot with what its update changed. When continuous is false
+		// updates were skipped or the state was read from scratch, and everything may have changed.
+		virtual void apply(const Changes::ChangeList& changes, bool continuous, const GameData& gamedata, const game_drawer_config& config) {}
 
 		virtual void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config) = 0;
+
+		// True while the layer changes from frame to frame without a new snapshot
+		virtual bool animating() const
+		{
+			return false;
+		}
+
+		// Area the layout is mapped into, the area of the spatial grids and the static tiles
+		static sf::FloatRect layout_area(const game_drawer_config& config)
+		{
+			return sf::FloatRect(0.f, 0.f, (float)config.window_videomode.width, (float)config.window_videomode.height);
+		}
+
+		// What the current view of the target shows, objects outside of it are not drawn
+		static sf::FloatRect visible_area(const sf::RenderTarget& target)
+		{
+			const sf::View& view = target.getView();
+			return sf::FloatRect(view.getCenter() - view.getSize() / 2.f, view.getSize());
+		}
+
+		// Pixels per layout unit of the current view of the target
+		static float pixel_scale(const sf::RenderTarget& target)
+		{
+			return target.getSize().x / target.getView().getSize().x;
+		}
+
+		// Loads the font on first use, every layer after that gets the same one
+		static const sf::Font& font(const game_drawer_config& config, const std::string& name)
+		{
+			sf::Font* val = config.fonts->GetResource(name);
+			if (val == nullptr && config.fonts->RequireResource(name)) val = config.fonts->GetResource(name);
+
+			if (val == nullptr) throw std::runtime_error("Failed to load font: " + name);
+			return *val;
+		}
+
+		// Full sprites and text, otherwise the simplified points and lines
+		static bool detailed(const sf::RenderTarget& target, const game_drawer_config& config)
+		{
+			return pixel_scale(target) >= config.detail_scale;
+		}
 	};
 
 
@@ -57,7 +183,13 @@ namespace game_drawer_layer {
 	{
 	public:
 
-		std::map<Graph::vertex_descriptor, sf::Sprite> nodes_g;
+		// One quad per vertex, in descriptor order
+		sf::VertexArray nodes_g = sf::VertexArray(sf::Quads);
+
+		// One point per vertex, drawn when zoomed out
+		sf::VertexArray points_g = sf::VertexArray(sf::Points);
+
+		spatial_grid<Graph::vertex_descriptor> grid;
 
 		vertecies() : layer_base() {}
 
@@ -65,60 +197,55 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::vertecies::init");
 
+			const size_t num_vertices = boost::num_vertices(gamedata.graph());
+
+			nodes_g.resize(num_vertices * 4);
+			points_g.resize(num_vertices);
+			grid.reset(layout_area(config), spatial_grid<Graph::vertex_descriptor>::cell_size_for(layout_area(config), num_vertices));
+
 			Graph::for_each_vertex_descriptor(gamedata.graph(), [&](Graph::vertex_descriptor v) {
 
-				sf::Sprite& s = nodes_g[v];
-				bool b = false;
+				const sf::IntRect* region = &config.atlas->region("cs");
+				sf::Vector2f size{ 25, 25 };
+				sf::Color color = sf::Color(128, 128, 128);
 
-				
-				if (gamedata.map_graph.graph[v].post_idx != UINT32_MAX) {
+				if (gamedata.map_graph->graph[v].post_idx != UINT32_MAX) {
 					switch (getPostType(v, gamedata)) {
 					case Posts::PostType::MARKET:
-						b = config.textures->RequireResource("market");
-						s = sf::Sprite(*config.textures->GetResource("market"));
+						region = &config.atlas->region("market");
+						color = sf::Color::Black;
 						break;
 					case  Posts::PostType::TOWN:
-						b = config.textures->RequireResource("castle");
-						s = sf::Sprite(*config.textures->GetResource("castle"));
+						region = &config.atlas->region("castle");
+						color = sf::Color(109, 37, 0, 255);
 						break;
 					case  Posts::PostType::STORAGE:
-						b = config.textures->RequireResource("storage");
-						s = sf::Sprite(*config.textures->GetResource("storage"));
+						region = &config.atlas->region("storage");
+						color = sf::Color::Blue;
 						break;
 					default:
 						break;
 					}
 
-					SpriteUtils::setSize(s, sf::Vector2f{ 40, 40 });
-				}
-				else {
-					b = config.textures->RequireResource("cs");
-					s = sf::Sprite(*config.textures->GetResource("cs"));
-
-					SpriteUtils::setSize(s, sf::Vector2f{ 25, 25 });
+					size = sf::Vector2f{ 40, 40 };
 				}
 
-				SpriteUtils::centerOrigin(s);
-
 				const CoordsHolder::point_type& vcoords = gamedata.map_graph_coords->get_map()[v];
-				s.setPosition(sf::Vector2f{
+				const sf::Vector2f position{
 						config.padding_width.map(vcoords[0]),
 						config.padding_height.map(vcoords[1])
-					});
+				};
+
+				QuadUtils::set(&nodes_g[v * 4], QuadUtils::centered(position, size, *region), *region);
+				points_g[v] = sf::Vertex(position, color);
+				grid.insert(QuadUtils::bounds(&nodes_g[v * 4]), v);
 				}
 			);
 		}
 
 		Posts::PostType getPostType(Graph::vertex_descriptor v, const GameData& gamedata) {
 
-			const Graph::VertexProperties& vprops = gamedata.map_graph.graph[v];
-
-			switch (gamedata.posts.at(vprops.post_idx)->type())
-			{
-			case Posts::TOWN: return Posts::TOWN;
-			case Posts::STORAGE: return Posts::STORAGE;
-			case Posts::MARKET: return Posts::MARKET;
-			}
+			return gamedata.posts.at_vertex(gamedata.map_graph->graph[v].idx).type;
 		}
 
 		void reset()
@@ -126,29 +253,30 @@ namespace game_drawer_layer {
 			LOG_3("game_drawer_layer::vertecies::reset");
 
 			nodes_g.clear();
+			points_g.clear();
+			grid.clear();
 		}
 
-		void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		bool is_static() const
 		{
-			for (const auto& vertex : nodes_g)
-			{
-				window.draw(vertex.second);
-			}
+			return true;
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
+		{
+			if (detailed(target, config)) target.draw(nodes_g, &config.atlas->texture());
+			else target.draw(points_g);
 		}
 
 		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
 		{
-			for (const auto& [v, node] : nodes_g)
-			{
-				if (node.getGlobalBounds().contains(pos))
+			grid.query(pos, [&](Graph::vertex_descriptor v) {
+				std::cout << "Vertex = " << Graph::encodeJSON_vertex(gamedata.graph(), v) << std::endl;
+				if (gamedata.map_graph->graph[v].post_idx != UINT32_MAX)
 				{
-					std::cout << "Vertex = " << Graph::encodeJSON_vertex(gamedata.graph(), v) << std::endl;
-					if (gamedata.map_graph.graph[v].post_idx != UINT32_MAX)
-					{
-						LOG("Post = " << gamedata.posts.at(gamedata.map_graph.graph[v].post_idx)->encodeJSON());
-					}
+					LOG("Post = " << gamedata.encodeJSON_Post(gamedata.map_graph->graph[v].post_idx));
 				}
-			}
+				});
 		}
 	};
 
@@ -156,7 +284,14 @@ namespace game_drawer_layer {
 
 	class edges : public layer_base
 	{
-		std::map<Graph::edge_descriptor, sf::Sprite> edges_g;
+		// The railway texture is laid along each edge in tiles, the last one cut to length
+		sf::VertexArray edges_g = sf::VertexArray(sf::Quads);
+
+		// One line per edge, drawn when zoomed out
+		sf::VertexArray lines_g = sf::VertexArray(sf::Lines);
+
+		// Bounds of the whole rail of every edge
+		spatial_grid<Graph::edge_descriptor> grid;
 
 	public:
 		edges() : layer_base() {}
@@ -166,22 +301,21 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::edges::init");
 
-			Graph::for_each_edge_descriptor(gamedata.graph(), [&](Graph::edge_descriptor e) {
+			edges_g.clear();
+			lines_g.clear();
+			grid.reset(layout_area(config), spatial_grid<Graph::edge_descriptor>::cell_size_for(layout_area(config), boost::num_edges(gamedata.graph())));
 
-				sf::Sprite& edge = edges_g[e];
+			const sf::IntRect& main_region = config.atlas->region("railway");
 
-				config.textures->RequireResource("railway");
+			Graph::for_each_edge_descriptor(gamedata.graph(), [&](Graph::edge_descriptor e) {
 
-				auto u = boost::source(e, gamedata.map_graph.graph);
-				auto v = boost::target(e, gamedata.map_graph.graph);
+				auto u = boost::source(e, gamedata.map_graph->graph);
+				auto v = boost::target(e, gamedata.map_graph->graph);
 
 				const auto& coords = gamedata.map_graph_coords->get_map();
 				if (coords[u][0] >= coords[v][0])
 					std::swap(u, v);
 
-				sf::Texture* main_texture = config.textures->GetResource("railway");
-				auto main_size = TextureUtils::getSize(*main_texture);
-
 				double vertecies_distance = sqrt(
 					Math::sqr(config.padding_width.map(coords[u][0]) - config.padding_width.map(coords[v][0])) +
 					Math::sqr(config.padding_height.map(coords[u][1]) - config.padding_height.map(coords[v][1]))
@@ -189,10 +323,8 @@ namespace game_drawer_layer {
 
 				const float edge_length_coeff = 0.1;
 
-				main_texture->setRepeated(true);
-				edge = sf::Sprite(*main_texture,
-					sf::IntRect(0, 0, main_size.x, round(vertecies_distance / edge_length_coeff)));
-				edge.setOrigin(sf::Vector2f{ main_size.x / 2.f, 0.f });
+				sf::Transformable edge;
+				edge.setOrigin(sf::Vector2f{ main_region.width / 2.f, 0.f });
 				edge.setPosition(
 					config.padding_width.map(coords[v][0]),
 					config.padding_height.map(coords[v][1])
@@ -214,6 +346,26 @@ namespace game_drawer_layer {
 				else {
 					edge.setRotation(90);
 				}
+
+				const float length = (float)round(vertecies_distance / edge_length_coeff);
+				const sf::Transform& transform = edge.getTransform();
+
+				for (float y = 0; y < length; y += main_region.height)
+				{
+					const float height = std::min<float>(main_region.height, length - y);
+
+					const size_t offset = edges_g.getVertexCount();
+					edges_g.resize(offset + 4);
+
+					QuadUtils::set(&edges_g[offset], transform,
+						sf::FloatRect(0.f, y, (float)main_region.width, height),
+						sf::FloatRect((float)main_region.left, (float)main_region.top, (float)main_region.width, height));
+				}
+
+				lines_g.append(sf::Vertex(sf::Vector2f(config.padding_width.map(coords[u][0]), config.padding_height.map(coords[u][1])), sf::Color(109, 37, 0, 255)));
+				lines_g.append(sf::Vertex(sf::Vector2f(config.padding_width.map(coords[v][0]), config.padding_height.map(coords[v][1])), sf::Color(109, 37, 0, 255)));
+
+				grid.insert(transform.transformRect(sf::FloatRect(0.f, 0.f, (float)main_region.width, length)), e);
 				});
 		}
 
@@ -221,36 +373,64 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::edges::reset");
 			edges_g.clear();
+			lines_g.clear();
+			grid.clear();
 		}
 
-		void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		bool is_static() const
 		{
-			for (const auto& edge : edges_g)
-			{
-				window.draw(edge.second);
-			}
+			return true;
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
+		{
+			if (detailed(target, config)) target.draw(edges_g, &config.atlas->texture());
+			else target.draw(lines_g);
 		}
 
 		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
 		{
-			for (const auto& [e, edge] : edges_g)
-			{
-				if (edge.getGlobalBounds().contains(pos))
-				{
-					LOG("Edge = " << Graph::encodeJSON_edge(gamedata.graph(), e));
-				}
-			}
+			grid.query(pos, [&](Graph::edge_descriptor e) {
+				LOG("Edge = " << Graph::encodeJSON_edge(gamedata.graph(), e));
+				});
 		}
 	};
 
 
 	class trains : public layer_base
 	{
-		std::map<Types::train_idx_t, sf::Sprite> trains_g;
-		std::map<Types::train_idx_t, const Trains::Train*> tMap;
+		// One quad per train, in the order of train_ids
+		sf::VertexArray trains_g = sf::VertexArray(sf::Quads);
+		std::vector<Types::train_idx_t> train_ids;
+
+		// One point per train, drawn when zoomed out
+		sf::VertexArray points_g = sf::VertexArray(sf::Points);
+
+		// Index in train_ids of every train quad, updated as the trains move
+		spatial_grid<size_t> grid;
 
 		std::map<Types::train_idx_t, sf::Text> trains_info;
-		sf::Font cashed_font;
+
+		// A moved train is drawn along from -> via -> to during the tick after the snapshot, via is the
+		// vertex between its old and new line. Only the quads of animated trains are touched per frame.
+		struct animation
+		{
+			sf::Vector2f from, via, to;
+			std::chrono::steady_clock::time_point start;
+		};
+
+		std::vector<animation> animations;
+		std::vector<size_t> animated;
+
+		// Line of every train at the last snapshot, and the bounds it has in the grid there
+		std::vector<Types::edge_idx_t> lines;
+		std::vector<sf::FloatRect> bounds;
+
+		// Time between the last snapshots that moved trains, what an animation takes
+		std::chrono::steady_clock::duration tick_time = std::chrono::seconds(1);
+		std::chrono::steady_clock::time_point last_moves;
+
+		const sf::IntRect* region = nullptr;
 
 	public:
 
@@ -260,103 +440,224 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::trains::init");
 
-			for (auto& player : gamedata.players)
-			{
-				for (auto& train : player.second.trains) {
-					sf::Sprite& s = trains_g[train.first];
-					tMap[train.first] = &train.second;
-
-					bool b = config.textures->RequireResource("train");
-					s = sf::Sprite(*config.textures->GetResource("train"));
-					SpriteUtils::setSize(s, sf::Vector2f{ 35, 35 });
-					SpriteUtils::centerOrigin(s);
-				}
-			}
-			cashed_font.loadFromFile(config.edge_length_font);
-			for (auto& p : trains_g) {
-				sf::Text& text = trains_info[p.first];
-				text.setFont(cashed_font);
+			train_ids = gamedata.trains.ids;
+			trains_g.clear();
+			trains_g.resize(train_ids.size() * 4);
+			points_g.resize(train_ids.size());
+			animations.assign(train_ids.size(), animation());
+			animated.clear();
+			lines.assign(train_ids.size(), 0);
+			bounds.assign(train_ids.size(), sf::FloatRect());
+			region = &config.atlas->region("train");
+			grid.reset(layout_area(config), spatial_grid<size_t>::cell_size_for(layout_area(config), train_ids.size()));
+
+			const sf::Font& arial = font(config, "arial");
+			for (Types::train_idx_t train_idx : train_ids) {
+				sf::Text& text = trains_info[train_idx];
+				text.setFont(arial);
 				text.setCharacterSize(24);
 				SpriteUtils::centerOrigin(text, sf::Vector2f(12, text.getCharacterSize()));
+				update_info(text, gamedata.trains[train_idx]);
+			}
+
+			for (size_t i = 0; i < train_ids.size(); i++)
+			{
+				update_position(i, gamedata, config, false);
 			}
 		}
 
-		void reset()
+		void update_info(sf::Text& text, const Trains::Train& t)
 		{
-			LOG_3("game_drawer_layer::edges::reset");
+			text.setString(std::to_string(t.goods));
 
-			trains_g.clear();
-			tMap.clear();
-			trains_info.clear();
+			if (t.goods_type == Trains::Armor)
+			{
+				text.setFillColor(sf::Color::Blue);
+			}
+			else if (t.goods_type == Trains::Product)
+			{
+				text.setFillColor(sf::Color::Black);
+			}
+			else {
+				text.setFillColor(sf::Color::Red);
+			}
 		}
 
-		void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		// Layout coordinates of the vertex shared by two lines, false if they share none
+		bool shared_vertex(Types::edge_idx_t a, Types::edge_idx_t b, const GameData& gamedata, const game_drawer_config& config, sf::Vector2f& result) const
 		{
-			for (auto& s : trains_g)
+			const auto& graph = gamedata.map_graph->graph;
+			const auto& ea = gamedata.map_graph->emap.at(a);
+			const auto& eb = gamedata.map_graph->emap.at(b);
+
+			for (const auto v : { boost::source(ea, graph), boost::target(ea, graph) })
 			{
-				const Trains::Train* t = tMap[s.first];
-				const auto& edge = gamedata.map_graph.emap.at(t->line_idx);
-				auto u = boost::source(edge, gamedata.map_graph.graph);
-				auto v = boost::target(edge, gamedata.map_graph.graph);
+				if (v == boost::source(eb, graph) || v == boost::target(eb, graph))
+				{
+					result = vertex_point(v, gamedata, config);
+					return true;
+				}
+			}
 
-				const auto& coords = gamedata.map_graph_coords->get_map();
+			return false;
+		}
 
-				double v_x_distance = config.padding_width.map(coords[u][0]) - config.padding_width.map(coords[v][0]);
-				double v_y_distance = config.padding_height.map(coords[u][1]) - config.padding_height.map(coords[v][1]);
+		// Draws the quad, the point and the text of the i-th train at center
+		void place(size_t i, const sf::Vector2f& center)
+		{
+			QuadUtils::set(&trains_g[i * 4], QuadUtils::centered(center, sf::Vector2f{ 35, 35 }, *region), *region);
+			points_g[i] = sf::Vertex(center, sf::Color::Red);
+			trains_info[train_ids[i]].setPosition(center);
+		}
+
+		// Moves the i-th train to where it is on its line, over the next tick when animated. Picking
+		// always sees the train where the server has it.
+		void update_position(size_t i, const GameData& gamedata, const game_drawer_config& config, bool animate)
+		{
+			const Trains::Train& t = gamedata.trains[train_ids[i]];
+			const sf::Vector2f center = line_point(t.line_idx, t.position, gamedata, config);
 
-				double edge_length = gamedata.map_graph.graph[edge].length;
-				float position = (float)t->position;
-				float koeff = position / edge_length;
+			if (animate)
+			{
+				animation& a = animations[i];
 
-				s.second.setPosition(
-					sf::Vector2f(
-						config.padding_width.map(coords[u][0]) + (float)v_x_distance * koeff,
-						config.padding_height.map(coords[u][1]) + (float)v_y_distance * koeff
-					));
-				window.draw(s.second);
+				a.from = points_g[i].position;
+				a.to = center;
+				if (t.line_idx == lines[i] || !shared_vertex(lines[i], t.line_idx, gamedata, config, a.via)) a.via = a.from;
+				a.start = std::chrono::steady_clock::now();
 
+				if (std::find(animated.begin(), animated.end(), i) == animated.end()) animated.push_back(i);
 			}
 
-			for (auto& p : trains_info) {
-				sf::Text& text = p.second;
-				const Trains::Train* t = tMap[p.first];
-				
-				text.setString(std::to_string(t->goods));
-				
-				if (t->goods_type == Trains::Armor)
+			lines[i] = t.line_idx;
+
+			if (!animate) place(i, center);
+
+			grid.erase(bounds[i], i);
+			bounds[i] = sf::FloatRect(center - sf::Vector2f(17.5f, 17.5f), sf::Vector2f(35.f, 35.f));
+			grid.insert(bounds[i], i);
+		}
+
+		// Quads are only moved for the trains that moved
+		void apply(const Changes::ChangeList& changes, bool continuous, const GameData& gamedata, const game_drawer_config& config)
+		{
+			if (!continuous)
+			{
+				animated.clear();
+
+				for (size_t i = 0; i < train_ids.size(); i++)
 				{
-					text.setFillColor(sf::Color::Blue);
+					update_info(trains_info[train_ids[i]], gamedata.trains[train_ids[i]]);
+					update_position(i, gamedata, config, false);
 				}
-				else if (t->goods_type == Trains::Product)
+				return;
+			}
+
+			changes.for_each(Changes::TRAIN_CARGO, [&](const Changes::Change& change) {
+				const auto it = trains_info.find(change.idx);
+				if (it != trains_info.end()) update_info(it->second, gamedata.trains[change.idx]);
+				});
+
+			bool moved = false;
+
+			changes.for_each(Changes::TRAIN_MOVED, [&](const Changes::Change& change) {
+				const auto it = std::lower_bound(train_ids.begin(), train_ids.end(), change.idx);
+				if (it != train_ids.end() && *it == change.idx)
 				{
-					text.setFillColor(sf::Color::Black);
-				}
-				else {
-					text.setFillColor(sf::Color::Red);
+					update_position(it - train_ids.begin(), gamedata, config, config.animate_trains);
+					moved = true;
 				}
+				});
 
-				text.setPosition(trains_g[p.first].getPosition());
-
-				window.draw(text);
+			if (moved)
+			{
+				const auto now = std::chrono::steady_clock::now();
+				if (last_moves.time_since_epoch().count() != 0) tick_time = std::min<std::chrono::steady_clock::duration>(now - last_moves, std::chrono::seconds(2));
+				last_moves = now;
 			}
 		}
 
-		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		bool animating() const
+		{
+			return !animated.empty();
+		}
+
+		// Moves the animated trains to where they are at this frame
+		void animate()
 		{
-			for (const auto& [train_idx, train] : trains_g)
+			const auto now = std::chrono::steady_clock::now();
+
+			for (size_t k = 0; k < animated.size();)
 			{
-				if (train.getGlobalBounds().contains(pos))
+				const size_t i = animated[k];
+				const animation& a = animations[i];
+
+				const float t = std::min(1.f, std::chrono::duration<float>(now - a.start) / std::chrono::duration<float>(tick_time));
+
+				// Both legs at the same speed, the first one ends at via
+				const float first = VectorUtils::length(a.via - a.from);
+				const float total = first + VectorUtils::length(a.to - a.via);
+				const float d = t * total;
+
+				if (d <= first && first > 0.f) place(i, a.from + (a.via - a.from) * (d / first));
+				else if (total > first) place(i, a.via + (a.to - a.via) * ((d - first) / (total - first)));
+				else place(i, a.to);
+
+				if (t >= 1.f)
 				{
-					LOG("Train = " << gamedata.trains.at(train_idx)->encodeJSON());
+					animated[k] = animated.back();
+					animated.pop_back();
 				}
+				else
+				{
+					k++;
+				}
+			}
+		}
+
+		void reset()
+		{
+			LOG_3("game_drawer_layer::edges::reset");
+
+			trains_g.clear();
+			points_g.clear();
+			train_ids.clear();
+			grid.clear();
+			trains_info.clear();
+			animations.clear();
+			animated.clear();
+			lines.clear();
+			bounds.clear();
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
+		{
+			animate();
+
+			if (!detailed(target, config))
+			{
+				target.draw(points_g);
+				return;
 			}
+
+			target.draw(trains_g, &config.atlas->texture());
+
+			grid.query(visible_area(target), [&](size_t i) {
+				target.draw(trains_info.at(train_ids[i]));
+				});
+		}
+
+		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		{
+			grid.query(pos, [&](size_t i) {
+				LOG("Train = " << gamedata.encodeJSON_Train(train_ids[i]));
+				});
 		}
 	};
 
 
 	class edges_length : public layer_base
 	{
-		sf::Font cached_font;
 		std::map<Types::edge_idx_t, sf::Text> cached_edges_length;
 
 	public:
@@ -367,12 +668,12 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::edges_length::init");
 
-			cached_font.loadFromFile(config.edge_length_font);
+			const sf::Font& arial = font(config, "arial");
 
 			Graph::for_each_edge_descriptor(gamedata.graph(), [&](Graph::edge_descriptor e) {
-				const CoordsHolder::point_type& es = gamedata.map_graph_coords->get_map()[boost::source(e, gamedata.map_graph.graph)];
-				const CoordsHolder::point_type& et = gamedata.map_graph_coords->get_map()[boost::target(e, gamedata.map_graph.graph)];
-				const Graph::EdgeProperties& eprops = gamedata.map_graph.graph[e];
+				const CoordsHolder::point_type& es = gamedata.map_graph_coords->get_map()[boost::source(e, gamedata.map_graph->graph)];
+				const CoordsHolder::point_type& et = gamedata.map_graph_coords->get_map()[boost::target(e, gamedata.map_graph->graph)];
+				const Graph::EdgeProperties& eprops = gamedata.map_graph->graph[e];
 
 				sf::Text& line_length = cached_edges_length[eprops.idx];
 				line_length.setString(std::to_string(eprops.length));
@@ -383,7 +684,7 @@ namespace game_drawer_layer {
 
 				line_length.setCharacterSize(24);
 				SpriteUtils::centerOrigin(line_length, sf::Vector2f(12, line_length.getCharacterSize() / 2.0f));
-				line_length.setFont(cached_font);
+				line_length.setFont(arial);
 				line_length.setFillColor(sf::Color::Red);
 				});
 		}
@@ -395,11 +696,18 @@ namespace game_drawer_layer {
 			cached_edges_length.clear();
 		}
 
-		void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		bool is_static() const
+		{
+			return true;
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
 		{
+			if (!detailed(target, config)) return;
+
 			for (const auto& edge : cached_edges_length)
 			{
-				window.draw(edge.second);
+				target.draw(edge.second);
 			}
 		}
 
@@ -412,9 +720,11 @@ namespace game_drawer_layer {
 
 	class posts_infos : public layer_base
 	{
-		sf::Font cached_font;
 		std::map<Types::post_idx_t, sf::Text> posts_texts;
 
+		// Bounds of the texts, which change with their strings
+		spatial_grid<Types::post_idx_t> grid;
+
 	public:
 
 		posts_infos() : layer_base() {}
@@ -423,34 +733,73 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::posts_infos::init");
 
-			cached_font.loadFromFile(config.edge_length_font);
+			const sf::Font& arial = font(config, "arial");
+
+			grid.reset(layout_area(config), spatial_grid<Types::post_idx_t>::cell_size_for(layout_area(config), gamedata.posts.size()));
 
-			for (auto& p : gamedata.posts) {
-				sf::Text& text = posts_texts[p.first];
+			gamedata.posts.for_each([&](Types::post_idx_t post_idx, Posts::PostRef post) {
+				sf::Text& text = posts_texts[post_idx];
 
 				text.setCharacterSize(20);
 				SpriteUtils::centerOrigin(text, sf::Vector2f(20, text.getCharacterSize()));
 
-				text.setFont(cached_font);
+				text.setFont(arial);
 
-				if (p.second->type() == Posts::MARKET) {
+				if (post.type == Posts::MARKET) {
 					text.setFillColor(sf::Color::Black);
 				}
-				else if (p.second->type() == Posts::STORAGE){
+				else if (post.type == Posts::STORAGE){
 					text.setFillColor(sf::Color::Blue);
 				}
-				else if (p.second->type() == Posts::TOWN) {
+				else if (post.type == Posts::TOWN) {
 					text.setFillColor(sf::Color(109, 37, 0, 255));
 				}
 
-				auto v_idx = p.second->point_idx;
-				auto v = gamedata.map_graph.vmap.at(v_idx);
+				auto v_idx = gamedata.posts.columns(post.type).point_idx[post.slot];
+				auto v = gamedata.map_graph->vmap.at(v_idx);
 				auto point = gamedata.map_graph_coords->get_map()[v];
 				text.setPosition(
 					config.padding_width.map(point[0]),
 					config.padding_height.map(point[1])
 				);
+
+				update_text(post_idx, text, post, gamedata.posts);
+				});
+		}
+
+		void update_text(Types::post_idx_t post_idx, sf::Text& text, Posts::PostRef post, const Posts::PostTables& posts)
+		{
+			grid.erase(text.getGlobalBounds(), post_idx);
+
+			if (post.type == Posts::MARKET) {
+				text.setString(std::to_string(posts.markets.product[post.slot]));
 			}
+			else if (post.type == Posts::STORAGE) {
+				text.setString(std::to_string(posts.storages.armor[post.slot]));
+			}
+			else if (post.type == Posts::TOWN) {
+				text.setString(std::to_string(posts.towns.product[post.slot])+"\n"+ (std::to_string(posts.towns.armor[post.slot])));
+			}
+
+			grid.insert(text.getGlobalBounds(), post_idx);
+		}
+
+		// Texts are only rebuilt for the posts whose stock changed
+		void apply(const Changes::ChangeList& changes, bool continuous, const GameData& gamedata, const game_drawer_config& config)
+		{
+			if (!continuous)
+			{
+				gamedata.posts.for_each([&](Types::post_idx_t post_idx, Posts::PostRef post) {
+					const auto it = posts_texts.find(post_idx);
+					if (it != posts_texts.end()) update_text(post_idx, it->second, post, gamedata.posts);
+					});
+				return;
+			}
+
+			changes.for_each(Changes::POST_STOCK, [&](const Changes::Change& change) {
+				const auto it = posts_texts.find(change.idx);
+				if (it != posts_texts.end()) update_text(change.idx, it->second, gamedata.posts.find(change.idx), gamedata.posts);
+				});
 		}
 
 		void reset()
@@ -458,27 +807,16 @@ namespace game_drawer_layer {
 			LOG_3("game_drawer_layer::edges_length::reset");
 
 			posts_texts.clear();
+			grid.clear();
 		}
 
-		void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
 		{
-			for (const auto& p : gamedata.posts) {
-				sf::Text& text = posts_texts[p.first];
+			if (!detailed(target, config)) return;
 
-				if (p.second->type() == Posts::MARKET) {
-					const Posts::Market* ptr = (Posts::Market*)p.second.get();
-					text.setString(std::to_string(ptr->product));
-				}
-				else if (p.second->type() == Posts::STORAGE) {
-					const Posts::Storage* ptr = (Posts::Storage*)p.second.get();
-					text.setString(std::to_string(ptr->armor));
-				}
-				else if (p.second->type() == Posts::TOWN) {
-					const Posts::Town* ptr = (Posts::Town*)p.second.get();
-					text.setString(std::to_string(ptr->product)+"\n"+ (std::to_string(ptr->armor)));
-				}
-				window.draw(text);
-			}
+			grid.query(visible_area(target), [&](Types::post_idx_t post_idx) {
+				target.draw(posts_texts.at(post_idx));
+				});
 		}
 
 		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
@@ -490,7 +828,7 @@ namespace game_drawer_layer {
 
 	class background : public layer_base
 	{
-		sf::Sprite bg;
+		sf::VertexArray bg = sf::VertexArray(sf::Quads, 4);
 
 	public:
 
@@ -500,10 +838,11 @@ namespace game_drawer_layer {
 		{
 			LOG_3("game_drawer_layer::background::init");
 
-			config.textures->RequireResource("bg");
-			sf::Texture* bg_texture = config.textures->GetResource("bg");
-			bg.setTexture(*bg_texture);
-			SpriteUtils::setSize(bg, sf::Vector2f( config.window_videomode.width, config.window_videomode.height ));
+			const sf::IntRect& region = config.atlas->region("bg");
+
+			sf::Transformable t;
+			t.setScale((float)config.window_videomode.width / region.width, (float)config.window_videomode.height / region.height);
+			QuadUtils::set(&bg[0], t.getTransform(), region);
 		}
 
 		void reset()
@@ -512,9 +851,14 @@ namespace game_drawer_layer {
 			//nothing
 		}
 
-		void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		bool is_static() const
 		{
-			window.draw(bg);
+			return true;
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
+		{
+			target.draw(bg, &config.atlas->texture());
 		}
 
 		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
@@ -523,6 +867,247 @@ namespace game_drawer_layer {
 		}
 	};
 
+	// What the solver intends: a congestion heatmap of the predicted edge occupancy under a polyline
+	// per planned route, toggled with F2. Built from the published PlanView into one vertex array
+	// when a plan arrives, so a frame is a single draw call.
+	class routes : public layer_base
+	{
+		sf::VertexArray batch = sf::VertexArray(sf::Quads);
+
+		// Read buffer of the plans, valid until the render thread picks up the next one
+		const PlanView* plan = nullptr;
+
+		bool visible = false;
+
+	public:
+
+		routes() : layer_base() {}
+
+		void toggle(const GameData& gamedata, const game_drawer_config& config)
+		{
+			visible = !visible;
+			rebuild(gamedata, config);
+		}
+
+		void set_plan(const PlanView& val, const GameData& gamedata, const game_drawer_config& config)
+		{
+			plan = &val;
+			rebuild(gamedata, config);
+		}
+
+		void init(const GameData& gamedata, const game_drawer_config& config)
+		{
+			LOG_3("game_drawer_layer::routes::init");
+
+			rebuild(gamedata, config);
+		}
+
+		void reset()
+		{
+			LOG_3("game_drawer_layer::routes::reset");
+
+			batch.clear();
+			plan = nullptr;
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
+		{
+			if (visible) target.draw(batch);
+		}
+
+		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		{
+
+		}
+
+	protected:
+
+		void rebuild(const GameData& gamedata, const game_drawer_config& config)
+		{
+			batch.clear();
+			if (!visible || plan == nullptr || gamedata.map_graph == nullptr) return;
+
+			const Graph::Graph& graph = gamedata.graph();
+
+			for (const PlanView::Occupancy& occupancy : plan->occupancy)
+			{
+				const float load = (float)occupancy.train_ticks / std::max<uint32_t>(plan->horizon, 1);
+
+				QuadUtils::append_line(batch,
+					vertex_point(boost::source(occupancy.edge, graph), gamedata, config),
+					vertex_point(boost::target(occupancy.edge, graph), gamedata, config),
+					12.f, heat_color(load));
+			}
+
+			for (size_t i = 0; i < plan->num_routes; i++)
+			{
+				const PlanView::Route& route = plan->routes[i];
+				const sf::Color color = route_color(i);
+
+				sf::Vector2f from = line_point(route.line_idx, route.position, gamedata, config);
+				for (const Graph::vertex_descriptor v : route.vertices)
+				{
+					const sf::Vector2f to = vertex_point(v, gamedata, config);
+					QuadUtils::append_line(batch, from, to, 4.f, color);
+					from = to;
+				}
+			}
+		}
+
+		// Green while a train uses the edge part of the horizon, yellow for one full train, red for two
+		static sf::Color heat_color(float load)
+		{
+			const float t = std::clamp(load / 2.f, 0.f, 1.f);
+
+			if (t < 0.5f) return sf::Color(sf::Uint8(510 * t), 200, 0, 150);
+			return sf::Color(255, sf::Uint8(200 * (1.f - t) * 2.f), 0, 150);
+		}
+
+		static sf::Color route_color(size_t i)
+		{
+			static const sf::Color palette[] = {
+				sf::Color(0, 114, 178, 220), sf::Color(230, 159, 0, 220), sf::Color(204, 121, 167, 220),
+				sf::Color(86, 180, 233, 220), sf::Color(0, 158, 115, 220), sf::Color(213, 94, 0, 220),
+			};
+			return palette[i % (sizeof(palette) / sizeof(palette[0]))];
+		}
+	};
+
+
+	// Performance figures in screen space over the other layers, toggled with F3. While hidden
+	// it neither reads the registry nor draws anything.
+	class hud : public layer_base
+	{
+		sf::Text text;
+		sf::RectangleShape panel;
+
+		bool visible = false;
+
+		// Frames drawn since second_start, for the FPS
+		size_t frames = 0;
+		float fps = 0.f;
+		std::chrono::steady_clock::time_point second_start;
+
+	public:
+
+		hud() : layer_base() {}
+
+		void toggle()
+		{
+			visible = !visible;
+			frames = 0;
+			second_start = std::chrono::steady_clock::now();
+		}
+
+		void init(const GameData& gamedata, const game_drawer_config& config)
+		{
+			LOG_3("game_drawer_layer::hud::init");
+
+			text.setFont(font(config, "arial"));
+			text.setCharacterSize(14);
+			text.setFillColor(sf::Color::White);
+			text.setPosition(10.f, 10.f);
+
+			panel.setFillColor(sf::Color(0, 0, 0, 160));
+			panel.setPosition(5.f, 5.f);
+		}
+
+		void reset()
+		{
+			LOG_3("game_drawer_layer::hud::reset");
+			//nothing
+		}
+
+		// Redrawn every frame while shown, the figures change without snapshots
+		bool animating() const
+		{
+			return visible;
+		}
+
+		void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
+		{
+			if (!visible || config.metrics == nullptr) return;
+
+			count_frame();
+			text.setString(describe(*config.metrics));
+
+			const sf::FloatRect bounds = text.getGlobalBounds();
+			panel.setSize(sf::Vector2f(bounds.left + bounds.width + 5.f, bounds.top + bounds.height + 5.f) - panel.getPosition());
+
+			// Screen space, whatever the camera shows. The default view keeps the size the window was
+			// created with, so the view follows the current size to keep the text unscaled after a resize
+			const sf::View view = target.getView();
+			target.setView(sf::View(sf::FloatRect(0.f, 0.f, (float)target.getSize().x, (float)target.getSize().y)));
+
+			target.draw(panel);
+			target.draw(text);
+
+			target.setView(view);
+		}
+
+		void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+		{
+
+		}
+
+	protected:
+
+		void count_frame()
+		{
+			frames++;
+
+			const auto now = std::chrono::steady_clock::now();
+			const float elapsed = std::chrono::duration<float>(now - second_start).count();
+
+			if (elapsed >= 1.f)
+			{
+				fps = frames / elapsed;
+				frames = 0;
+				second_start = now;
+			}
+		}
+
+		std::string describe(const metrics_registry& metrics) const
+		{
+			const auto ms = [&](metrics_registry::metric m) { return metrics.last(m) / 1e6; };
+
+			std::stringstream ss;
+			ss << std::fixed << std::setprecision(2);
+
+			ss << "FPS " << std::setprecision(1) << fps << std::setprecision(2) << ", frame " << ms(metrics_registry::FRAME_TIME) << " ms\n";
+			ss << "L1 parse " << ms(metrics_registry::L1_PARSE) << " ms, p50 " << metrics.histogram(metrics_registry::L1_PARSE).percentile(50) / 1e6 << " ms\n";
+
+			ss << "Solver " << ms(metrics_registry::SOLVER_TOTAL) << " ms:";
+			for (const metrics_registry::metric m : { metrics_registry::SOLVER_UPGRADES, metrics_registry::SOLVER_STATES, metrics_registry::SOLVER_TURNS, metrics_registry::SOLVER_COLLISIONS })
+			{
+				ss << " " << metrics_registry::name(m) << " " << ms(m);
+			}
+			ss << "\n";
+
+			ss << "Allocations per tick ";
+			if (alloc_stats::enabled) ss << metrics.last(metrics_registry::TICK_ALLOCATIONS) << "\n";
+			else ss << "not counted\n";
+
+			ss << "Turn budget " << std::setprecision(1) << metrics.remaining_turn_budget().count() / 1e3 << " s" << std::setprecision(2) << "\n";
+
+			ss << "RTT p50 (ms):";
+			if (metrics.network != nullptr)
+			{
+				for (uint32_t action = 0; action < network_stats::MAX_ACTION; action++)
+				{
+					const latency_histogram& histogram = metrics.network->rtt_histogram(action);
+					if (histogram.count() != 0) ss << " " << network_stats::action_name(action) << " " << histogram.percentile(50) / 1e6;
+				}
+			}
+			else
+			{
+				ss << " not measured";
+			}
+
+			return ss.str();
+		}
+	};
+
 } // namespace game_drawer_layer
 
 
@@ -539,22 +1124,43 @@ class game_drawer
 protected:
 	const game_drawer_config& config;
 
-	sf::Clock clock_;
-	sf::Time elapsed_;
-
 	boost::ptr_vector<game_drawer_layer::layer_base> layers;
-	
+
+	// Seq of the last change list handed to the layers
+	uint64_t changes_seq = 0;
+
+	// Static layers rendered into tiles per zoom level, dropped on init
+	tile_cache static_tiles;
+
+	// Toggled with F2 and F3
+	game_drawer_layer::routes* routes_layer = nullptr;
+	game_drawer_layer::hud* hud_layer = nullptr;
+
+	// What part of the layout the window shows, see update for the controls
+	sf::View camera;
+	sf::Vector2u window_size;
+	bool dragging = false;
+	sf::Vector2i drag_last;
+
 public:
 
 	game_drawer(const GameData& gamedata, const game_drawer_config& config)
-		: config(config), clock_()
+		: config(config)
 	{
 		layers.push_back(new game_drawer_layer::background());
 		layers.push_back(new game_drawer_layer::edges());
 		layers.push_back(new game_drawer_layer::vertecies());
 		//layers.push_back(new game_drawer_layer::edges_length());
+
+		// Static layers are composited first, keep them below the dynamic ones
+		routes_layer = new game_drawer_layer::routes();
+		layers.push_back(routes_layer);
+
 		layers.push_back(new game_drawer_layer::posts_infos());
 		layers.push_back(new game_drawer_layer::trains());
+
+		hud_layer = new game_drawer_layer::hud();
+		layers.push_back(hud_layer);
 	}
 
 	void init(const GameData& gamedata)
@@ -565,13 +1171,36 @@ public:
 		{
 			layer.init(gamedata, config);
 		}
+
+		changes_seq = gamedata.changes.seq;
+		static_tiles.invalidate();
 	}
 
-	void restart_clock() {
-		elapsed_ += clock_.restart();
+	// Hands the changes of a new snapshot to the layers
+	void apply(const GameData& gamedata)
+	{
+		const bool continuous = gamedata.changes.continues(changes_seq);
+
+		for (game_drawer_layer::layer_base& layer : layers)
+		{
+			layer.apply(gamedata.changes, continuous, gamedata, config);
+		}
+
+		changes_seq = gamedata.changes.seq;
+	}
+
+	// True while a layer needs frames without a new snapshot
+	bool animating() const
+	{
+		for (const game_drawer_layer::layer_base& layer : layers)
+		{
+			if (layer.animating()) return true;
+		}
+
+		return false;
 	}
 
-	void handle_input(sf::RenderWindow& window, const GameData& gamedata, const status& s) {
+	void handle_input(sf::RenderWindow& window, const GameData& gamedata, status s) {
 
 	
 	}
@@ -584,6 +1213,8 @@ public:
 		{
 			layer.reset();
 		}
+
+		static_tiles.invalidate();
 	}
 
 	void onMouseClick(const sf::Vector2f& pos, sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
@@ -606,7 +1237,7 @@ public:
 		{
 			case sf::Keyboard::P:
 			{
-				for (const auto& [player_idx, player] : gamedata.players)
+				for (const Player& player : gamedata.players)
 				{
 					LOG("Player = " << player.encodeJSON());
 				}
@@ -618,15 +1249,23 @@ public:
 
 	
 
-	void draw(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config)
+	// Draws every layer into a window or an offscreen texture
+	void draw(sf::RenderTarget& target, const GameData& gamedata, const game_drawer_config& config)
 	{
+		static_tiles.draw(target, game_drawer_layer::layer_base::layout_area(config), [&](sf::RenderTarget& tile) {
+			for (game_drawer_layer::layer_base& layer : layers)
+			{
+				if (layer.is_static()) layer.draw(tile, gamedata, config);
+			}
+			});
+
 		for (game_drawer_layer::layer_base& layer : layers)
 		{
-			layer.draw(window, gamedata, config);
+			if (!layer.is_static()) layer.draw(target, gamedata, config);
 		}
 	}
 
-	void render(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config, const status& s)
+	void render(sf::RenderWindow& window, const GameData& gamedata, const game_drawer_config& config, status s)
 	{
 		switch (s)
 		{
@@ -650,88 +1289,210 @@ public:
 			} break;
 		}
 
-		if(s == status::READY)
+		if (s == status::READY)
+		{
+			const metrics_registry::scoped_timer timer(config.metrics, metrics_registry::FRAME_TIME);
+
+			window.setView(camera);
 			draw(window, gamedata, config);
+		}
 
 		window.display();
 	}
 
-	void start(sf::RenderWindow& window, const GameData& gamedata, game_drawer_config& config, const status& s)
+	// Shows the whole layout, keeping its aspect ratio
+	void reset_camera(sf::RenderWindow& window, const game_drawer_config& config)
+	{
+		const sf::FloatRect area = game_drawer_layer::layer_base::layout_area(config);
+
+		window_size = window.getSize();
+		const float scale = std::min(window_size.x / area.width, window_size.y / area.height);
+
+		camera = sf::View(sf::Vector2f(area.left + area.width / 2.f, area.top + area.height / 2.f), sf::Vector2f(window_size.x / scale, window_size.y / scale));
+	}
+
+	// Zooms by factor, keeping the layout point under the pixel in place
+	void zoom_camera(sf::RenderWindow& window, const sf::Vector2i& pixel, float factor, const game_drawer_config& config)
+	{
+		const float scale = window.getSize().x / camera.getSize().x;
+		factor = std::clamp(scale * factor, config.min_zoom, config.max_zoom) / scale;
+
+		const sf::Vector2f before = window.mapPixelToCoords(pixel, camera);
+		camera.zoom(1.f / factor);
+		camera.move(before - window.mapPixelToCoords(pixel, camera));
+	}
+
+	// Moves the camera by a distance in pixels
+	void pan_camera(sf::RenderWindow& window, const sf::Vector2f& pixels)
+	{
+		camera.move(pixels.x * camera.getSize().x / window.getSize().x, pixels.y * camera.getSize().y / window.getSize().y);
+	}
+
+	// Draws the latest snapshot published by the game loop, see Game::publish_snapshot.
+	// A frame is only drawn when the snapshot, the state or the window changed, at most one every
+	// frame_time; in between the thread sleeps on the scheduler and wakes up to poll window events.
+	void start(sf::RenderWindow& window, triple_buffer<GameData>& snapshots, triple_buffer<PlanView>& plans, game_drawer_config& config, const std::atomic<status>& state, render_scheduler& scheduler)
 	{
 		LOG_2("game_drawer: start");
 
-		init(gamedata);
+		snapshots.update();
+		init(snapshots.read_buffer());
+		reset_camera(window, config);
+
+		const auto frame_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(config.frame_time));
+		const auto input_poll_time = std::chrono::duration<float>(config.input_poll_time);
+
+		auto next_frame = std::chrono::steady_clock::now();
+		bool redraw = true;
+		status last_status = state.load(std::memory_order_acquire);
 
 		while (window.isOpen())
 		{
-			try {	
-				this->handle_input(window, gamedata, s);
-				this->update(window, gamedata, config, s);
-				this->render(window, gamedata, config, s);
-				this->restart_clock();
+			if (snapshots.update())
+			{
+				this->apply(snapshots.read_buffer());
+				redraw = true;
+			}
+
+			if (plans.update())
+			{
+				routes_layer->set_plan(plans.read_buffer(), snapshots.read_buffer(), config);
+				redraw = true;
+			}
+
+			const GameData& gamedata = snapshots.read_buffer();
+			const status s = state.load(std::memory_order_acquire);
+
+			if (s != last_status)
+			{
+				last_status = s;
+				redraw = true;
 			}
-			catch (boost::thread_interrupted&)
+
+			this->handle_input(window, gamedata, s);
+			redraw |= this->update(window, gamedata, config, s);
+			redraw |= s == status::READY && this->animating();
+
+			if (redraw && std::chrono::steady_clock::now() >= next_frame)
 			{
-				LOG_2("game_render: Render thread interrupted");
+				this->render(window, gamedata, config, s);
+
+				next_frame = std::chrono::steady_clock::now() + frame_time;
+				redraw = false;
 			}
+
+			// A pending redraw waits for the next frame, otherwise for news or the next input poll
+			if (redraw) std::this_thread::sleep_until(std::min(next_frame, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(input_poll_time)));
+			else scheduler.wait_for(input_poll_time);
 		}
 	}
 
-	void update(sf::RenderWindow& window, const GameData& gamedata, game_drawer_config& config, const status& s) {
+	// Handles the pending window events, true if the window has to be drawn again
+	// Wheel zooms at the cursor, the right button drags the camera, arrows pan and Home shows everything.
+	// F2 shows the planned routes, F3 the HUD.
+	bool update(sf::RenderWindow& window, const GameData& gamedata, game_drawer_config& config, status s) {
 
-		
-		if (elapsed_.asSeconds() >= config.frame_time)
+		bool redraw = false;
+
+		sf::Event event;
+		while (window.pollEvent(event))
 		{
-			sf::Event event;
-			while (window.pollEvent(event))
+			switch(event.type)
 			{
-				switch(event.type)
+				case sf::Event::Closed:
+				{
+					window.close();
+					exit(0);
+				} break;
+				case sf::Event::Resized:
+				{
+					// Only the view changes: the layout keeps its pixels per unit and the window shows
+					// more or less of it, the cached geometry and tiles stay valid
+					const sf::Vector2u size(event.size.width, event.size.height);
+					camera.setSize(camera.getSize().x * size.x / window_size.x, camera.getSize().y * size.y / window_size.y);
+					window_size = size;
+
+					redraw = true;
+				} break;
+				case sf::Event::GainedFocus:
 				{
-					case sf::Event::Closed:
+					redraw = true;
+				} break;
+				case sf::Event::MouseButtonPressed:
+				{
+					const sf::Vector2i pixel(event.mouseButton.x, event.mouseButton.y);
+
+					if (event.mouseButton.button == sf::Mouse::Right)
 					{
-						window.close();
-						exit(0);
-					} break;
-					case sf::Event::Resized:
+						dragging = true;
+						drag_last = pixel;
+					}
+					else
 					{
-						const sf::Vector2u size = window.getSize();
-						config.padding_width.set_output(size.x / 10, size.x * 9 / 10);
-						config.padding_height.set_output(size.y / 10, size.y * 9 / 10);
+						onMouseClick(window.mapPixelToCoords(pixel, camera), window, gamedata, config);
+					}
+				} break;
+				case sf::Event::MouseButtonReleased:
+				{
+					if (event.mouseButton.button == sf::Mouse::Right) dragging = false;
+				} break;
+				case sf::Event::MouseMoved:
+				{
+					if (!dragging) break;
+
+					const sf::Vector2i pixel(event.mouseMove.x, event.mouseMove.y);
+					pan_camera(window, sf::Vector2f(drag_last - pixel));
+					drag_last = pixel;
+					redraw = true;
+				} break;
+				case sf::Event::MouseWheelScrolled:
+				{
+					if (event.mouseWheelScroll.wheel != sf::Mouse::VerticalWheel) break;
 
-						config.window_videomode.width = size.x;
-						config.window_videomode.height = size.y;
-						window.setView(sf::View(sf::Vector2f(size.x / 2, size.y / 2), sf::Vector2f(size.x, size.y)));
+					zoom_camera(window, sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y), std::pow(1.25f, event.mouseWheelScroll.delta), config);
+					redraw = true;
+				} break;
+				case sf::Event::KeyPressed:
+				{
+					const sf::Vector2f step(window.getSize().x / 10.f, window.getSize().y / 10.f);
 
-						init(gamedata);
-					} break;
-					case sf::Event::MouseButtonPressed:
-					{
-						onMouseClick(sf::Vector2f(event.mouseButton.x, event.mouseButton.y), window, gamedata, config);
-					} break;
-					case sf::Event::KeyPressed:
+					switch (event.key.code)
 					{
-						onKeyboardPress(event, window, gamedata, config);
-					} break;
-				}
-				
+						case sf::Keyboard::Left: pan_camera(window, sf::Vector2f(-step.x, 0.f)); redraw = true; break;
+						case sf::Keyboard::Right: pan_camera(window, sf::Vector2f(step.x, 0.f)); redraw = true; break;
+						case sf::Keyboard::Up: pan_camera(window, sf::Vector2f(0.f, -step.y)); redraw = true; break;
+						case sf::Keyboard::Down: pan_camera(window, sf::Vector2f(0.f, step.y)); redraw = true; break;
+						case sf::Keyboard::Home: reset_camera(window, config); redraw = true; break;
+						case sf::Keyboard::F2: routes_layer->toggle(gamedata, config); redraw = true; break;
+						case sf::Keyboard::F3: hud_layer->toggle(); redraw = true; break;
+						default:
+						{
+							onKeyboardPress(event, window, gamedata, config);
+						} break;
+					}
+				} break;
 			}
-
-			elapsed_ -= sf::seconds(config.frame_time);
+			
 		}
+
+		return redraw;
 	}
 };
 
-void game_drawer_thread(const GameData& gamedata, game_drawer_config& config, const status& s, sf::RenderWindow*& callback)
+void game_drawer_thread(triple_buffer<GameData>& snapshots, triple_buffer<PlanView>& plans, game_drawer_config& config, const std::atomic<status>& s, render_scheduler& scheduler, std::promise<sf::RenderWindow*>& window_ready)
 {
 	LOG_2("game_drawer_thread: Creating RenderWindow...");
 	sf::RenderWindow window(config.window_videomode, config.window_name);
-	LOG_2("game_drawer_thread: Saving RenderWindow pointer...");
-	callback = &window;
+	LOG_2("game_drawer_thread: Handing out RenderWindow pointer...");
+	window_ready.set_value(&window);
 	
 
+	LOG_2("game_drawer_thread: Building texture atlas...");
+	config.atlas->build();
+
 	LOG_2("game_drawer_thread: Creating game_drawer...");
-	game_drawer drawer(gamedata, config);
+	game_drawer drawer(snapshots.read_buffer(), config);
 
 	LOG_2("game_drawer_thread: Starting draw loop...");
-	drawer.start(window, gamedata, config, s);
-}
\ No newline at end of file
+	drawer.start(window, snapshots, plans, config, s, scheduler);
+}
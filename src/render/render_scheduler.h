@@ -0,0 +1,47 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+
+// Wakes the render thread when there is something new to draw, so it can sleep in between.
+//
+// Producers call notify() after publishing a snapshot or changing the drawer state. Window events can
+// only be read on the window's own thread and can not signal the scheduler, so the render thread never
+// waits longer than its input poll interval.
+class render_scheduler
+{
+public:
+
+	render_scheduler() = default;
+
+	render_scheduler(const render_scheduler&) = delete;
+	render_scheduler& operator=(const render_scheduler&) = delete;
+
+	void notify()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = true;
+		}
+		cv.notify_one();
+	}
+
+	// True if notified since the last wait, false on timeout
+	template <class Rep, class Period>
+	bool wait_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		const bool notified = cv.wait_for(lock, timeout, [this]() { return pending; });
+		pending = false;
+		return notified;
+	}
+
+protected:
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool pending = false;
+};
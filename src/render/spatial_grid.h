@@ -0,0 +1,170 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+
+// Uniform grid over the screen bounds of drawn objects, for picking and culling without a linear scan.
+//
+// An item is stored in every cell its bounds overlap, bounds outside the area clamp to the border
+// cells. A point query looks at one cell, a rect query at the cells it overlaps and reports every item
+// once: only from the first cell shared by the item and the rect. The grid is rebuilt by reset() and
+// insert() whenever the layout changes, moving items are updated with erase() and insert().
+template <class T>
+class spatial_grid
+{
+public:
+
+	struct entry
+	{
+		sf::FloatRect bounds;
+		T item;
+	};
+
+	// Cell size that puts about items_per_cell items of count in a cell when they are spread evenly
+	static float cell_size_for(const sf::FloatRect& area, size_t count, float min_size = 16.f, size_t items_per_cell = 4)
+	{
+		if (count == 0) return std::max(area.width, area.height);
+
+		return std::max(min_size, std::sqrt(area.width * area.height * items_per_cell / count));
+	}
+
+	void reset(const sf::FloatRect& area, float cell_size)
+	{
+		this->area = area;
+		this->cell_size = std::max(cell_size, 1.f);
+
+		columns = std::max<int>(1, (int)std::ceil(area.width / this->cell_size));
+		rows = std::max<int>(1, (int)std::ceil(area.height / this->cell_size));
+
+		cells.resize(size_t(columns) * rows);
+		for (std::vector<entry>& cell : cells)
+		{
+			cell.clear();
+		}
+	}
+
+	void clear()
+	{
+		cells.clear();
+		columns = rows = 0;
+	}
+
+	bool empty() const
+	{
+		return cells.empty();
+	}
+
+	void insert(const sf::FloatRect& bounds, const T& item)
+	{
+		if (cells.empty()) return;
+
+		const cell_range range = cells_of(bounds);
+
+		for (int y = range.top; y <= range.bottom; y++)
+		{
+			for (int x = range.left; x <= range.right; x++)
+			{
+				cell(x, y).push_back({ bounds, item });
+			}
+		}
+	}
+
+	// Removes the item inserted with these bounds, does nothing if it was not inserted
+	void erase(const sf::FloatRect& bounds, const T& item)
+	{
+		if (cells.empty()) return;
+
+		const cell_range range = cells_of(bounds);
+
+		for (int y = range.top; y <= range.bottom; y++)
+		{
+			for (int x = range.left; x <= range.right; x++)
+			{
+				std::vector<entry>& entries = cell(x, y);
+
+				const auto it = std::find_if(entries.begin(), entries.end(), [&](const entry& e) { return e.item == item; });
+				if (it != entries.end())
+				{
+					*it = entries.back();
+					entries.pop_back();
+				}
+			}
+		}
+	}
+
+	// Calls f(item) for every item whose bounds contain pos
+	template <class Func>
+	void query(const sf::Vector2f& pos, Func f) const
+	{
+		if (cells.empty()) return;
+
+		for (const entry& e : cell(column_of(pos.x), row_of(pos.y)))
+		{
+			if (e.bounds.contains(pos)) f(e.item);
+		}
+	}
+
+	// Calls f(item) once for every item whose bounds intersect rect
+	template <class Func>
+	void query(const sf::FloatRect& rect, Func f) const
+	{
+		if (cells.empty()) return;
+
+		const cell_range range = cells_of(rect);
+
+		for (int y = range.top; y <= range.bottom; y++)
+		{
+			for (int x = range.left; x <= range.right; x++)
+			{
+				for (const entry& e : cell(x, y))
+				{
+					if (!e.bounds.intersects(rect)) continue;
+
+					if (std::max(column_of(e.bounds.left), range.left) == x && std::max(row_of(e.bounds.top), range.top) == y) f(e.item);
+				}
+			}
+		}
+	}
+
+protected:
+
+	struct cell_range
+	{
+		int left, top, right, bottom;
+	};
+
+	int column_of(float x) const
+	{
+		return std::clamp((int)std::floor((x - area.left) / cell_size), 0, columns - 1);
+	}
+
+	int row_of(float y) const
+	{
+		return std::clamp((int)std::floor((y - area.top) / cell_size), 0, rows - 1);
+	}
+
+	cell_range cells_of(const sf::FloatRect& bounds) const
+	{
+		return { column_of(bounds.left), row_of(bounds.top), column_of(bounds.left + bounds.width), row_of(bounds.top + bounds.height) };
+	}
+
+	std::vector<entry>& cell(int x, int y)
+	{
+		return cells[size_t(y) * columns + x];
+	}
+
+	const std::vector<entry>& cell(int x, int y) const
+	{
+		return cells[size_t(y) * columns + x];
+	}
+
+	sf::FloatRect area;
+	float cell_size = 1.f;
+	int columns = 0, rows = 0;
+
+	std::vector<std::vector<entry>> cells;
+};
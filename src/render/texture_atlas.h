@@ -0,0 +1,132 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <src/globals/working_directory.h>
+#include <src/utils/Logging.h>
+
+
+// All textures of a paths file packed into one sf::Texture, so a layer draws every one of its
+// sprites with a single textured vertex array, see QuadUtils.
+//
+// The paths file has the format of ResourceManager, one "<name> <path>" per line. Images are packed
+// on shelves, tallest first, with a gutter so filtering never samples a neighbour. Textures can only
+// be created with a GL context, so build() is left to the render thread.
+class texture_atlas
+{
+public:
+
+	explicit texture_atlas(const std::string& paths_file)
+	{
+		std::ifstream file(WORKING_DIRECTORY + paths_file);
+		if (!file.is_open()) throw std::runtime_error("Failed to open texture paths: " + paths_file);
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::stringstream linestream(line);
+
+			std::string name, path;
+			if (linestream >> name >> path) paths.emplace_back(name, WORKING_DIRECTORY + path);
+		}
+	}
+
+	texture_atlas(const texture_atlas&) = delete;
+	texture_atlas& operator=(const texture_atlas&) = delete;
+
+	bool built() const
+	{
+		return is_built;
+	}
+
+	void build()
+	{
+		if (is_built) return;
+
+		std::vector<sf::Image> images(paths.size());
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			if (!images[i].loadFromFile(paths[i].second)) throw std::runtime_error("Failed to load texture: " + paths[i].second);
+		}
+
+		// Shelf packing, tallest first
+		std::vector<size_t> order(paths.size());
+		for (size_t i = 0; i < order.size(); i++) order[i] = i;
+
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return images[a].getSize().y > images[b].getSize().y; });
+
+		const unsigned max_width = std::min(MAX_WIDTH, sf::Texture::getMaximumSize());
+
+		unsigned x = 0, y = 0, shelf_height = 0, width = 0;
+
+		for (size_t i : order)
+		{
+			const sf::Vector2u size = images[i].getSize();
+			if (size.x + GUTTER > max_width) throw std::runtime_error("Texture does not fit in the atlas: " + paths[i].second);
+
+			if (x + size.x + GUTTER > max_width)
+			{
+				x = 0;
+				y += shelf_height;
+				shelf_height = 0;
+			}
+
+			regions[paths[i].first] = sf::IntRect(x, y, size.x, size.y);
+
+			x += size.x + GUTTER;
+			shelf_height = std::max(shelf_height, size.y + GUTTER);
+			width = std::max(width, x);
+		}
+
+		const unsigned height = y + shelf_height;
+		if (height > sf::Texture::getMaximumSize()) throw std::runtime_error("Texture atlas is too large");
+
+		sf::Image atlas;
+		atlas.create(width, height, sf::Color::Transparent);
+
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			const sf::IntRect& region = regions[paths[i].first];
+			atlas.copy(images[i], region.left, region.top);
+		}
+
+		if (!atlas_texture.loadFromImage(atlas)) throw std::runtime_error("Failed to create the texture atlas");
+		atlas_texture.setSmooth(true);
+
+		is_built = true;
+
+		LOG_2("texture_atlas::build: Packed " << paths.size() << " textures into " << width << "x" << height);
+	}
+
+	const sf::Texture& texture() const
+	{
+		return atlas_texture;
+	}
+
+	// Pixel rectangle of the named texture in the atlas
+	const sf::IntRect& region(const std::string& name) const
+	{
+		const auto it = regions.find(name);
+		if (it == regions.end()) throw std::out_of_range("No texture in the atlas: " + name);
+		return it->second;
+	}
+
+protected:
+
+	static constexpr unsigned MAX_WIDTH = 4096;
+	static constexpr unsigned GUTTER = 2;
+
+	std::vector<std::pair<std::string, std::string>> paths;
+	std::unordered_map<std::string, sf::IntRect> regions;
+
+	sf::Texture atlas_texture;
+	bool is_built = false;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <map>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <src/utils/Logging.h>
+
+
+// Content that rarely changes, rendered once into fixed size tiles per zoom level and then only blitted.
+//
+// The zoom of the target view is rounded to a power of two, the level, and every level has its own
+// grid of TILE_SIZE pixel tiles, so tiles stay sharp at every zoom. A draw only renders the tiles of
+// the view that are not cached yet, then draws the cached ones as sprites. The least recently drawn
+// tiles are dropped beyond max_tiles, their textures are reused for new tiles.
+class tile_cache
+{
+public:
+
+	static constexpr unsigned TILE_SIZE = 256;
+
+	static constexpr int MIN_LEVEL = -4;
+	static constexpr int MAX_LEVEL = 4;
+
+	size_t max_tiles = 128;
+
+	tile_cache() = default;
+
+	tile_cache(const tile_cache&) = delete;
+	tile_cache& operator=(const tile_cache&) = delete;
+
+	// Drops every tile, the content changed
+	void invalidate()
+	{
+		for (auto& [key, val] : tiles)
+		{
+			spare.push_back(std::move(val.texture));
+		}
+
+		tiles.clear();
+	}
+
+	// Draws the part of area visible in the target, draw_content(tile_target) renders a missing tile
+	template <class Func>
+	void draw(sf::RenderTarget& target, const sf::FloatRect& area, Func draw_content)
+	{
+		frame++;
+
+		const sf::View& view = target.getView();
+		const sf::FloatRect visible(view.getCenter() - view.getSize() / 2.f, view.getSize());
+
+		sf::FloatRect covered;
+		if (!visible.intersects(area, covered)) return;
+
+		const int level = level_of(target);
+		const float tile_world = TILE_SIZE / std::ldexp(1.f, level);
+
+		const int left = (int)std::floor(covered.left / tile_world);
+		const int top = (int)std::floor(covered.top / tile_world);
+		const int right = (int)std::ceil((covered.left + covered.width) / tile_world);
+		const int bottom = (int)std::ceil((covered.top + covered.height) / tile_world);
+
+		for (int y = top; y < bottom; y++)
+		{
+			for (int x = left; x < right; x++)
+			{
+				const auto [it, inserted] = tiles.try_emplace(key_t{ level, x, y });
+				tile& t = it->second;
+
+				if (inserted) render(t, sf::FloatRect(x * tile_world, y * tile_world, tile_world, tile_world), draw_content);
+
+				t.used = frame;
+				target.draw(t.sprite);
+			}
+		}
+
+		evict();
+	}
+
+	size_t size() const
+	{
+		return tiles.size();
+	}
+
+	// Zoom level of the view, its pixels per world unit rounded to a power of two
+	static int level_of(const sf::RenderTarget& target)
+	{
+		const float scale = target.getSize().x / target.getView().getSize().x;
+		return std::clamp((int)std::lround(std::log2(scale)), MIN_LEVEL, MAX_LEVEL);
+	}
+
+protected:
+
+	struct key_t
+	{
+		int level, x, y;
+
+		bool operator<(const key_t& other) const
+		{
+			if (level != other.level) return level < other.level;
+			if (y != other.y) return y < other.y;
+			return x < other.x;
+		}
+	};
+
+	struct tile
+	{
+		std::unique_ptr<sf::RenderTexture> texture;
+		sf::Sprite sprite;
+		uint64_t used = 0;
+	};
+
+	template <class Func>
+	void render(tile& t, const sf::FloatRect& world, Func draw_content)
+	{
+		if (!spare.empty())
+		{
+			t.texture = std::move(spare.back());
+			spare.pop_back();
+		}
+		else
+		{
+			t.texture = std::make_unique<sf::RenderTexture>();
+			if (!t.texture->create(TILE_SIZE, TILE_SIZE)) throw std::runtime_error("Failed to create a tile texture");
+		}
+
+		t.texture->setView(sf::View(world));
+		t.texture->clear(sf::Color::Transparent);
+		draw_content(*t.texture);
+		t.texture->display();
+
+		t.sprite.setTexture(t.texture->getTexture(), true);
+		t.sprite.setPosition(world.left, world.top);
+		t.sprite.setScale(world.width / TILE_SIZE, world.height / TILE_SIZE);
+
+		LOG_3("tile_cache::render: Tile at " << world.left << ", " << world.top << " of size " << world.width);
+	}
+
+	void evict()
+	{
+		while (tiles.size() > max_tiles)
+		{
+			auto oldest = tiles.begin();
+			for (auto it = tiles.begin(); it != tiles.end(); ++it)
+			{
+				if (it->second.used < oldest->second.used) oldest = it;
+			}
+
+			// Everything left is on screen
+			if (oldest->second.used == frame) return;
+
+			spare.push_back(std::move(oldest->second.texture));
+			tiles.erase(oldest);
+		}
+	}
+
+	std::map<key_t, tile> tiles;
+	std::vector<std::unique_ptr<sf::RenderTexture>> spare;
+
+	uint64_t frame = 0;
+};
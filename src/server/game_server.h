@@ -0,0 +1,160 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <filesystem>
+
+#include <src/server/game_session.h>
+
+
+struct game_server_config
+{
+	std::string maps_dir = "res/Server/maps";
+	std::string default_map = "small";
+
+	game_world_config world;
+};
+
+
+// Protocol-compatible stand-in for the game server, hosting any number of games and connections
+class game_server
+{
+public:
+
+	game_server(boost::asio::io_service& io, unsigned short port, const game_server_config& config)
+		: io(io), acceptor(io, tcp::endpoint(tcp::v4(), port)), config(config)
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(config.maps_dir))
+		{
+			if (entry.is_directory())
+			{
+				server_map map = server_map::load(entry.path());
+				maps.emplace(map.name, std::move(map));
+			}
+		}
+
+		if (maps.find(config.default_map) == maps.end()) throw std::runtime_error("Default map not found: " + config.default_map);
+
+		LOG("game_server: Loaded " << maps.size() << " map(s), listening on port " << port);
+	}
+
+	void start()
+	{
+		accept();
+	}
+
+	void stop()
+	{
+		boost::system::error_code ec;
+		acceptor.close(ec);
+	}
+
+	std::shared_ptr<game_world> join(const server_connector::Login& login)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		collect_empty();
+
+		const std::string game_name = login.game.value_or("Game of " + login.name);
+
+		auto world_it = worlds.find(game_name);
+		if (world_it == worlds.end())
+		{
+			LOG_1("game_server: Creating game " << game_name);
+
+			auto world = std::make_shared<game_world>(io, game_name, maps.at(config.default_map),
+				login.num_players.value_or(1), login.num_turns.value_or(-1), config.world);
+
+			world_it = worlds.emplace(game_name, std::move(world)).first;
+		}
+
+		return world_it->second;
+	}
+
+	json encodeJSON_Games()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		collect_empty();
+
+		json j;
+		j["games"] = json::array();
+
+		for (const auto& [game_name, world] : worlds)
+		{
+			const LobbyData info = world->info();
+
+			j["games"].push_back({
+				{"name", info.name},
+				{"num_players", info.num_players},
+				{"num_turns", info.num_turns},
+				{"state", info.state}
+				});
+		}
+
+		return j;
+	}
+
+protected:
+
+	void accept()
+	{
+		acceptor.async_accept([this](const boost::system::error_code& ec, tcp::socket socket) {
+			if (!acceptor.is_open()) return;
+
+			if (!ec)
+			{
+				socket.set_option(tcp::no_delay(true));
+				std::make_shared<game_session>(std::move(socket), *this)->start();
+			}
+
+			accept();
+			});
+	}
+
+	void collect_empty()
+	{
+		for (auto it = worlds.begin(); it != worlds.end();)
+		{
+			if (it->second->info().state != LobbyData::INIT && it->second->empty()) it = worlds.erase(it);
+			else ++it;
+		}
+	}
+
+	boost::asio::io_service& io;
+	tcp::acceptor acceptor;
+	const game_server_config config;
+
+	std::map<std::string, server_map> maps;
+
+	std::mutex mutex;
+	std::map<std::string, std::shared_ptr<game_world>> worlds;
+};
+
+
+inline game_session::Result game_session::login(const json& j, std::string& response)
+{
+	server_connector::Login login;
+
+	j["name"].get_to(login.name);
+	if (j.contains("password")) login.password = j["password"].get<std::string>();
+	if (j.contains("game")) login.game = j["game"].get<std::string>();
+	if (j.contains("num_turns")) login.num_turns = j["num_turns"].get<Types::tick_t>();
+	if (j.contains("num_players")) login.num_players = j["num_players"].get<uint8_t>();
+
+	if (world != nullptr) world->leave(player_idx);
+
+	world = server.join(login);
+
+	const Result result = world->login(login, player_idx, response);
+	if (result != Result::OKEY) world = nullptr;
+
+	return result;
+}
+
+inline game_session::Result game_session::games(std::string& response)
+{
+	response = server.encodeJSON_Games().dump();
+	return Result::OKEY;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include <boost/asio.hpp>
+#include <boost/endian/conversion.hpp>
+
+#include <src/server/game_world.h>
+#include <src/utils/bincharstream.h>
+#include <src/utils/binstream.h>
+
+
+class game_server;
+
+// One client connection of the local server, speaking the server_connector framing:
+// request  = [Action:u32][size:u32][json]
+// response = [Result:u32][size:u32][json]
+class game_session : public std::enable_shared_from_this<game_session>
+{
+public:
+
+	using Action = server_connector::Action;
+	using Result = server_connector::Result;
+
+	// Largest request body accepted, bigger ones are answered with an error and the connection closed
+	static constexpr uint32_t MAX_BODY_LENGTH = 1 << 20;
+
+	game_session(tcp::socket socket, game_server& server)
+		: socket(std::move(socket)), strand(this->socket.get_executor()), server(server) {}
+
+	~game_session()
+	{
+		if (world != nullptr) world->leave(player_idx);
+	}
+
+	void start()
+	{
+		LOG_2("game_session: Client connected");
+
+		read_header();
+	}
+
+protected:
+
+	static std::string _encodeResult(Result result, const std::string& data)
+	{
+		uint32_t _result = boost::endian::native_to_little((uint32_t)result);
+		uint32_t _length = boost::endian::native_to_little((uint32_t)data.length());
+		std::stringstream out;
+		writeStreamBinary(out, _result);
+		writeStreamBinary(out, _length);
+		out << data;
+		return out.str();
+	}
+
+	void read_header()
+	{
+		boost::asio::async_read(socket, boost::asio::buffer(header), boost::asio::transfer_exactly(sizeof(header)),
+			boost::asio::bind_executor(strand, [self = shared_from_this()](const boost::system::error_code& ec, std::size_t size) {
+				if (ec) return self->close();
+
+				BinCharIStream parser(self->header);
+				const Action action = (Action)boost::endian::little_to_native(parser.read<uint32_t>());
+				const uint32_t length = boost::endian::little_to_native(parser.read<uint32_t>());
+
+				self->read_body(action, length);
+			}));
+	}
+
+	void read_body(Action action, uint32_t length)
+	{
+		if (length > MAX_BODY_LENGTH)
+		{
+			LOG_2("game_session: Request of " << length << " bytes rejected");
+
+			std::string response;
+			const Result result = error(Result::BAD_COMMAND, "Request too large", response);
+			reply(result, response);
+			return close_after_write();
+		}
+
+		body.resize(length);
+
+		boost::asio::async_read(socket, boost::asio::buffer(body), boost::asio::transfer_exactly(length),
+			boost::asio::bind_executor(strand, [self = shared_from_this(), action](const boost::system::error_code& ec, std::size_t size) {
+				if (ec) return self->close();
+
+				self->dispatch(action);
+			}));
+	}
+
+	void dispatch(Action action)
+	{
+		LOG_3("game_session: {Action:" << action << ",data:" << body << "}");
+
+		std::string response;
+		Result result;
+
+		try
+		{
+			const json j = body.empty() ? json::object() : json::parse(body);
+
+			if (action == Action::LOGIN) result = login(j, response);
+			else if (action == Action::GAMES) result = games(response);
+			else if (world == nullptr) result = error(Result::ACCESS_DENIED, "Login required", response);
+			else switch (action)
+			{
+			case Action::LOGOUT:
+			{
+				world->leave(player_idx);
+				world = nullptr;
+				reply(Result::OKEY, "");
+				return close_after_write();
+			}
+			case Action::TURN:
+			{
+				// Requests are answered in order, so the next one is read only after the turn ends
+				world->turn(player_idx, [self = shared_from_this()](Result result, const std::string& response) {
+					self->reply(result, response);
+					boost::asio::post(self->strand, [self]() { self->read_header(); });
+				});
+				return;
+			}
+			case Action::PLAYER: result = world->player(player_idx, response); break;
+			case Action::MAP: result = world->map_layer(j["layer"].get<uint8_t>(), response); break;
+			case Action::MOVE:
+			{
+				server_connector::Move move;
+				j["line_idx"].get_to(move.line_idx);
+				j["speed"].get_to(move.speed);
+				j["train_idx"].get_to(move.train_idx);
+
+				result = world->move(player_idx, move, response);
+			} break;
+			case Action::UPGRADE:
+			{
+				server_connector::Upgrade upgrade;
+				if (j.contains("posts")) j["posts"].get_to(upgrade.posts);
+				if (j.contains("trains")) j["trains"].get_to(upgrade.trains);
+
+				result = world->upgrade(player_idx, upgrade, response);
+			} break;
+			default: result = error(Result::BAD_COMMAND, "Unknown action", response); break;
+			}
+		}
+		catch (const std::exception& err)
+		{
+			result = error(Result::BAD_COMMAND, err.what(), response);
+		}
+
+		reply(result, response);
+		read_header();
+	}
+
+	Result login(const json& j, std::string& response);
+
+	Result games(std::string& response);
+
+	static Result error(Result result, const std::string& message, std::string& response)
+	{
+		response = json{ {"error", message} }.dump();
+		return result;
+	}
+
+	void reply(Result result, const std::string& response)
+	{
+		boost::asio::post(strand, [self = shared_from_this(), packet = _encodeResult(result, response)]() mutable {
+			self->write_queue.push_back(std::move(packet));
+			if (self->write_queue.size() == 1) self->write_next();
+		});
+	}
+
+	void write_next()
+	{
+		boost::asio::async_write(socket, boost::asio::buffer(write_queue.front()),
+			boost::asio::bind_executor(strand, [self = shared_from_this()](const boost::system::error_code& ec, std::size_t size) {
+				if (ec) return self->close();
+
+				self->write_queue.pop_front();
+				if (!self->write_queue.empty()) self->write_next();
+				else if (self->closing) self->close();
+			}));
+	}
+
+	void close_after_write()
+	{
+		boost::asio::post(strand, [self = shared_from_this()]() {
+			self->closing = true;
+			if (self->write_queue.empty()) self->close();
+		});
+	}
+
+	void close()
+	{
+		LOG_2("game_session: Client disconnected");
+
+		boost::system::error_code ec;
+		socket.shutdown(tcp::socket::shutdown_both, ec);
+		socket.close(ec);
+	}
+
+	tcp::socket socket;
+	boost::asio::strand<tcp::socket::executor_type> strand;
+	game_server& server;
+
+	char header[8];
+	std::string body;
+	std::deque<std::string> write_queue;
+	bool closing = false;
+
+	std::shared_ptr<game_world> world;
+	Types::player_uid_t player_idx;
+};
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <chrono>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <boost/uuid/name_generator_sha1.hpp>
+
+#include <src/game/simulator.h>
+#include <src/server/map.h>
+#include <src/lobby/data.h>
+
+
+struct game_world_config
+{
+	uint32_t trains_per_player = 4;
+	uint32_t turn_timeout_ms = 10000;
+
+	GameSimulatorConfig simulator;
+};
+
+
+// One game hosted by the local server. Every public method is safe to call from any io thread.
+class game_world : public std::enable_shared_from_this<game_world>
+{
+public:
+
+	using Result = server_connector::Result;
+	using Reply = std::function<void(Result, const std::string&)>;
+
+	game_world(boost::asio::io_service& io, const std::string& name, const server_map& map, uint8_t num_players, Types::tick_t num_turns, const game_world_config& config)
+		: name(name), map(map), num_players(num_players), num_turns(num_turns), config(config),
+		simulator(config.simulator), turn_timer(io)
+	{
+		GameData::readJSON_L0(data, json::parse(map.layer0));
+		GameData::readJSON_L1(data, json::parse(map.layer1));
+	}
+
+	LobbyData info() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		LobbyData val;
+		val.name = name;
+		val.num_players = num_players;
+		val.num_turns = num_turns;
+		val.state = state;
+		return val;
+	}
+
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return online_players() == 0;
+	}
+
+	//------------------------------ ACTIONS ------------------------------//
+
+	Result login(const server_connector::Login& login, Types::player_uid_t& player_idx, std::string& response)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const auto name_it = player_names.find(login.name);
+		if (name_it != player_names.end())
+		{
+			world_player& wp = world_players.at(name_it->second);
+			if (wp.password != login.password) return error(Result::ACCESS_DENIED, "Password mismatch", response);
+
+			player_idx = name_it->second;
+			wp.online = true;
+
+			response = encodeJSON_Player(player_idx).dump();
+			return Result::OKEY;
+		}
+
+		if (state != LobbyData::INIT) return error(Result::INAPPROPRIATE_GAME_STATE, "Game is already started", response);
+
+		const uint32_t town = data.posts.towns.find_owned(Players::NONE);
+		if (town == Posts::Towns::NPOS) return error(Result::INAPPROPRIATE_GAME_STATE, "No free towns left on the map", response);
+
+		player_idx = boost::uuids::to_string(boost::uuids::name_generator_sha1(boost::uuids::ns::oid())(this->name + "/" + login.name));
+
+		const Types::player_id_t player_id = data.players.intern(player_idx);
+		data.posts.towns.owner[town] = player_id;
+
+		Player& player = data.players[player_id];
+		player.name = login.name;
+		player.rating = 0;
+
+		for (uint32_t i = 0; i < config.trains_per_player; i++)
+		{
+			Trains::Train& train = data.trains.add(next_train_idx++, player_id);
+			train.level = 1;
+			train.cooldown = 0;
+			train.goods = 0;
+			train.goods_type = Trains::None;
+			GameSimulator::place_train(data, train, data.posts.towns.point_idx[town]);
+		}
+
+		player_names[login.name] = player_idx;
+		world_players[player_idx] = { login.password, true };
+
+		LOG_1("game_world[" << name << "]: Player " << login.name << " joined (" << (uint32_t)world_players.size() << "/" << (uint32_t)num_players << ")");
+
+		if (world_players.size() >= num_players)
+		{
+			start();
+		}
+
+		response = encodeJSON_Player(player_idx).dump();
+		return Result::OKEY;
+	}
+
+	void leave(const Types::player_uid_t& player_idx)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const auto wp_it = world_players.find(player_idx);
+		if (wp_it == world_players.end()) return;
+
+		wp_it->second.online = false;
+		pending_turns.erase(player_idx);
+
+		if (online_players() == 0)
+		{
+			turn_timer.cancel();
+		}
+		else if (state == LobbyData::RUN && pending_turns.size() >= online_players())
+		{
+			tick();
+		}
+	}
+
+	Result player(const Types::player_uid_t& player_idx, std::string& response) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		response = encodeJSON_Player(player_idx).dump();
+		return Result::OKEY;
+	}
+
+	Result map_layer(uint8_t layer, std::string& response) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		switch (layer)
+		{
+		case 0: response = map.layer0; return Result::OKEY;
+		case 1: response = encodeJSON_L1().dump(); return Result::OKEY;
+		case 10: response = map.layer10; return Result::OKEY;
+		default: return error(Result::RESOURCE_NOT_FOUND, "Unknown map layer", response);
+		}
+	}
+
+	Result move(const Types::player_uid_t& player_idx, const server_connector::Move& move, std::string& response)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (state != LobbyData::RUN) return error(Result::INAPPROPRIATE_GAME_STATE, "Game is not running", response);
+
+		if (!data.trains.contains(move.train_idx)) return error(Result::RESOURCE_NOT_FOUND, "Train not found", response);
+		if (data.trains.owner[move.train_idx] != data.players.find(player_idx)) return error(Result::ACCESS_DENIED, "Train belongs to another player", response);
+
+		if (!GameSimulator::apply_Move(data, move)) return error(Result::BAD_COMMAND, "Move is not possible", response);
+
+		response.clear();
+		return Result::OKEY;
+	}
+
+	Result upgrade(const Types::player_uid_t& player_idx, const server_connector::Upgrade& upgrade, std::string& response)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (state != LobbyData::RUN) return error(Result::INAPPROPRIATE_GAME_STATE, "Game is not running", response);
+
+		if (!GameSimulator::apply_Upgrade(data, upgrade, data.players.find(player_idx))) return error(Result::BAD_COMMAND, "Upgrade is not possible", response);
+
+		response.clear();
+		return Result::OKEY;
+	}
+
+	// The reply is deferred until every online player has ended the turn or the turn times out
+	void turn(const Types::player_uid_t& player_idx, Reply reply)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (state == LobbyData::FINISHED)
+		{
+			std::string response;
+			reply(error(Result::INAPPROPRIATE_GAME_STATE, "Game is finished", response), response);
+			return;
+		}
+
+		pending_turns[player_idx] = std::move(reply);
+
+		if (state == LobbyData::RUN && pending_turns.size() >= online_players())
+		{
+			tick();
+		}
+	}
+
+protected:
+
+	struct world_player
+	{
+		std::optional<std::string> password;
+		bool online;
+	};
+
+	static Result error(Result result, const std::string& message, std::string& response)
+	{
+		response = json{ {"error", message} }.dump();
+		return result;
+	}
+
+	size_t online_players() const
+	{
+		return std::count_if(world_players.begin(), world_players.end(), [](const auto& wp) {
+			return wp.second.online;
+			});
+	}
+
+	json encodeJSON_Player(const Types::player_uid_t& player_idx) const
+	{
+		const Types::player_id_t player_id = data.players.find(player_idx);
+
+		json j = data.players[player_id].encodeJSON();
+		j["in_game"] = (state == LobbyData::RUN);
+		j["trains"] = json::array();
+
+		data.trains.for_each_owned(player_id, [&](const Trains::Train& train) {
+			j["trains"].push_back(data.encodeJSON_Train(train.idx));
+			});
+
+		const Posts::Towns& towns = data.posts.towns;
+
+		const uint32_t town = towns.find_owned(player_id);
+		if (town != Posts::Towns::NPOS)
+		{
+			j["home"] = { {"idx", towns.point_idx[town]}, {"post_idx", towns.idx[town]} };
+			j["town"] = data.encodeJSON_Post(towns.idx[town]);
+		}
+
+		return j;
+	}
+
+	json encodeJSON_L1() const
+	{
+		json j;
+
+		j["tick"] = tick_idx;
+		j["posts"] = json::array();
+		j["trains"] = json::array();
+		j["ratings"] = json::object();
+
+		data.posts.for_each([&](Types::post_idx_t post_idx, Posts::PostRef post) {
+			j["posts"].push_back(data.encodeJSON_Post(post_idx));
+			});
+
+		for (Types::train_idx_t train_idx : data.trains.ids)
+		{
+			j["trains"].push_back(data.encodeJSON_Train(train_idx));
+		}
+
+		for (const Player& player : data.players)
+		{
+			j["ratings"][player.idx] = player.encodeJSON();
+		}
+
+		return j;
+	}
+
+	void release_turns()
+	{
+		for (auto& [player_idx, reply] : pending_turns)
+		{
+			reply(Result::OKEY, "");
+		}
+		pending_turns.clear();
+	}
+
+	void start()
+	{
+		LOG_1("game_world[" << name << "]: Game started");
+
+		state = LobbyData::RUN;
+
+		// Turns sent while waiting for players only await the start
+		release_turns();
+		start_turn_timer();
+	}
+
+	void tick()
+	{
+		turn_timer.cancel();
+
+		simulator.step(data, ++tick_idx);
+
+		if (num_turns != -1 && tick_idx >= num_turns)
+		{
+			LOG_1("game_world[" << name << "]: Game finished on tick " << tick_idx);
+			state = LobbyData::FINISHED;
+		}
+
+		release_turns();
+
+		if (state == LobbyData::RUN)
+		{
+			start_turn_timer();
+		}
+	}
+
+	void start_turn_timer()
+	{
+		const Types::tick_t expected_tick = tick_idx;
+
+		turn_timer.expires_after(std::chrono::milliseconds(config.turn_timeout_ms));
+		turn_timer.async_wait([self = shared_from_this(), expected_tick](const boost::system::error_code& ec) {
+			if (ec) return;
+
+			std::lock_guard<std::mutex> lock(self->mutex);
+			if (self->state == LobbyData::RUN && self->tick_idx == expected_tick)
+			{
+				LOG_2("game_world[" << self->name << "]: Turn timeout on tick " << expected_tick);
+				self->tick();
+			}
+			});
+	}
+
+	mutable std::mutex mutex;
+
+	const std::string name;
+	const server_map& map;
+	const uint8_t num_players;
+	const Types::tick_t num_turns;
+	const game_world_config config;
+
+	LobbyData::GameState state = LobbyData::INIT;
+	Types::tick_t tick_idx = 0;
+	Types::train_idx_t next_train_idx = 1;
+
+	GameData data;
+	GameSimulator simulator;
+
+	std::map<std::string, Types::player_uid_t> player_names;
+	std::map<Types::player_uid_t, world_player> world_players;
+	std::map<Types::player_uid_t, Reply> pending_turns;
+
+	boost::asio::steady_timer turn_timer;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include <src/utils/Logging.h>
+
+
+// Map as served by the local server: raw layer payloads read from <maps_dir>/<name>/layer*.json
+struct server_map
+{
+	std::string name;
+
+	std::string layer0;
+	std::string layer1;
+	std::string layer10;
+
+	static std::string read_file(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) throw std::runtime_error("Failed to open map file: " + path.string());
+
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		return buffer.str();
+	}
+
+	static server_map load(const std::filesystem::path& dir)
+	{
+		LOG_2("server_map::load: Loading map " << dir);
+
+		server_map val;
+
+		val.name = dir.filename().string();
+		val.layer0 = read_file(dir / "layer0.json");
+		val.layer1 = read_file(dir / "layer1.json");
+		val.layer10 = read_file(dir / "layer10.json");
+
+		return val;
+	}
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <src/game.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <memory>
+
+
+struct SessionsConfig
+{
+	struct Session
+	{
+		std::string addr;
+		std::string port;
+
+		server_connector::Login login;
+	};
+
+	size_t solver_threads = std::thread::hardware_concurrency();
+
+	// Traffic of every session is captured to <capture_dir>/<name>.cap when set
+	std::string capture_dir;
+
+	// Parsed maps persist in <map_cache_dir> across runs when set
+	std::string map_cache_dir;
+
+	// Every frames_interval-th tick of a session is drawn to <frames_dir>/<name>/tick_<N>.png when set
+	std::string frames_dir;
+	uint32_t frames_interval = 1;
+
+	// Run the solver speculatively during the Turn round trip
+	bool speculative = false;
+
+	// Every session keeps a snapshot in <snapshot_dir>/<name>.snap when set, and starts from it with restore
+	std::string snapshot_dir;
+	bool restore = false;
+
+	// Network stats of all sessions are dumped at this interval, 0 only dumps them at the end
+	uint32_t stats_interval_ms = 0;
+
+	std::vector<Session> sessions;
+
+	// One option per line, '#' starts a comment, '-' leaves an optional field empty:
+	//   solver_threads <N>
+	//   capture_dir <path>
+	//   map_cache_dir <path>
+	//   frames_dir <path>
+	//   frames_interval <N>
+	//   stats_interval_ms <N>
+	//   speculative <0|1>
+	//   snapshot_dir <path>
+	//   restore <0|1>
+	//   session <addr> <port> <name> [password] [game] [num_turns] [num_players]
+	static SessionsConfig load(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open()) throw std::runtime_error("Failed to open sessions config: " + path);
+
+		SessionsConfig val;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::stringstream linestream(line.substr(0, line.find('#')));
+
+			std::string key;
+			if (!(linestream >> key)) continue;
+
+			if (key == "solver_threads") linestream >> val.solver_threads;
+			else if (key == "capture_dir") linestream >> val.capture_dir;
+			else if (key == "map_cache_dir") linestream >> val.map_cache_dir;
+			else if (key == "frames_dir") linestream >> val.frames_dir;
+			else if (key == "frames_interval") linestream >> val.frames_interval;
+			else if (key == "stats_interval_ms") linestream >> val.stats_interval_ms;
+			else if (key == "speculative") linestream >> val.speculative;
+			else if (key == "snapshot_dir") linestream >> val.snapshot_dir;
+			else if (key == "restore") linestream >> val.restore;
+			else if (key == "session")
+			{
+				Session& session = val.sessions.emplace_back();
+
+				std::string password, game, num_turns, num_players;
+				linestream >> session.addr >> session.port >> session.login.name >> password >> game >> num_turns >> num_players;
+
+				if (session.login.name.empty()) throw std::runtime_error("Session without a name: " + line);
+
+				if (!password.empty() && password != "-") session.login.password = password;
+				if (!game.empty() && game != "-") session.login.game = game;
+				if (!num_turns.empty() && num_turns != "-") session.login.num_turns = std::stoll(num_turns);
+				if (!num_players.empty() && num_players != "-") session.login.num_players = std::stoi(num_players);
+			}
+			else throw std::runtime_error("Unknown sessions config option: " + key);
+		}
+
+		return val;
+	}
+};
+
+
+// Runs many independent headless games in one process.
+// Sessions share one map cache, one solver pool and the network stats. The game loop does blocking
+// socket I/O, so every session still runs on its own thread; the shared io_service only owns the sockets.
+class Sessions
+{
+public:
+
+	Sessions(const SessionsConfig& config)
+		: config(config), solver_pool(config.solver_threads)
+	{
+		maps.directory = config.map_cache_dir;
+	}
+
+	void run()
+	{
+		LOG("Sessions: Starting " << config.sessions.size() << " session(s)...");
+
+		std::unique_ptr<network_stats_reporter> reporter;
+		if (config.stats_interval_ms > 0)
+		{
+			reporter = std::make_unique<network_stats_reporter>(stats, std::chrono::milliseconds(config.stats_interval_ms));
+		}
+
+		std::vector<std::thread> session_threads;
+		for (const SessionsConfig::Session& session : config.sessions)
+		{
+			session_threads.emplace_back(&Sessions::run_session, this, std::cref(session));
+		}
+
+		for (std::thread& thread : session_threads)
+		{
+			thread.join();
+		}
+
+		LOG("Sessions: All sessions finished");
+
+		if (reporter == nullptr) stats.dump(std::cout);
+	}
+
+protected:
+
+	void run_session(const SessionsConfig::Session& session)
+	{
+		try
+		{
+			server_connector connector(io);
+			connector.stats = &stats;
+
+			std::unique_ptr<traffic_capture> capture;
+			if (!config.capture_dir.empty())
+			{
+				capture = std::make_unique<traffic_capture>(config.capture_dir + "/" + session.login.name + ".cap");
+				connector.capture = capture.get();
+			}
+
+			Game game(connector);
+			game.drawer_mode = render_mode::HEADLESS;
+			if (!config.frames_dir.empty())
+			{
+				game.drawer_mode = render_mode::CAPTURE;
+				game.frames_dir = config.frames_dir + "/" + session.login.name;
+				game.frames_interval = config.frames_interval;
+			}
+			game.maps = &maps;
+			game.solver_pool = &solver_pool;
+			game.speculative = config.speculative;
+			if (!config.snapshot_dir.empty())
+			{
+				game.snapshot_path = config.snapshot_dir + "/" + session.login.name + ".snap";
+				game.restore_snapshot = config.restore;
+			}
+
+			game.connect(session.addr, session.port);
+
+			LOG("Sessions[" << session.login.name << "]: Starting the game..");
+			game.start(session.login);
+		}
+		catch (server_connector::Result err)
+		{
+			LOG("Sessions[" << session.login.name << "]: Session ended with code " << err);
+		}
+		catch (boost::system::system_error& err)
+		{
+			LOG("Sessions[" << session.login.name << "]: Connection error: " << err.what());
+		}
+		catch (const std::exception& err)
+		{
+			LOG("Sessions[" << session.login.name << "]: Error! " << err.what());
+		}
+	}
+
+	const SessionsConfig config;
+
+	boost::asio::io_service io;
+
+	map_cache maps;
+	thread_pool solver_pool;
+
+	network_stats stats;
+};
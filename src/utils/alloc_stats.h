@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+
+// Process-wide count of heap allocations, for per-tick allocation reports.
+//
+// Counting replaces the global operator new and is only compiled with COUNT_ALLOCATIONS defined,
+// otherwise allocations() stays 0. The replacement may only be defined once per program, so with
+// COUNT_ALLOCATIONS this header must be reached from exactly one translation unit.
+namespace alloc_stats {
+
+	inline std::atomic<uint64_t> count{ 0 };
+
+#ifdef COUNT_ALLOCATIONS
+	constexpr bool enabled = true;
+#else
+	constexpr bool enabled = false;
+#endif
+
+	inline uint64_t allocations()
+	{
+		return count.load(std::memory_order_relaxed);
+	}
+}
+
+
+#ifdef COUNT_ALLOCATIONS
+
+void* operator new(std::size_t size)
+{
+	alloc_stats::count.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* ptr = std::malloc(size != 0 ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+#endif
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+
+// HDR-style log-linear histogram of non-negative integer values.
+// Values below 64 are exact, larger ones keep 5 significant bits (about 3% relative error).
+// Recording and reading are lock-free, so one histogram can be fed by many threads and read by another.
+class latency_histogram
+{
+public:
+
+	static constexpr uint32_t SUB_BITS = 5;
+	static constexpr uint32_t SUB_COUNT = 1 << SUB_BITS;
+	static constexpr uint32_t BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+	static uint32_t bucket_of(uint64_t value)
+	{
+		if (value < 2 * SUB_COUNT) return (uint32_t)value;
+
+		const uint32_t msb = most_significant_bit(value);
+		const uint32_t shift = msb - SUB_BITS;
+
+		return (shift + 1) * SUB_COUNT + (uint32_t)((value >> shift) - SUB_COUNT);
+	}
+
+	// Smallest value that falls into the bucket
+	static uint64_t bucket_low(uint32_t idx)
+	{
+		if (idx < 2 * SUB_COUNT) return idx;
+
+		const uint32_t shift = idx / SUB_COUNT - 1;
+
+		return (uint64_t)(idx % SUB_COUNT + SUB_COUNT) << shift;
+	}
+
+	static uint64_t bucket_width(uint32_t idx)
+	{
+		if (idx < 2 * SUB_COUNT) return 1;
+
+		return uint64_t(1) << (idx / SUB_COUNT - 1);
+	}
+
+	void record(uint64_t value)
+	{
+		buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t prev = m_min.load(std::memory_order_relaxed);
+		while (value < prev && !m_min.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+
+		prev = m_max.load(std::memory_order_relaxed);
+		while (value > prev && !m_max.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+	}
+
+	uint64_t count() const
+	{
+		return m_count.load(std::memory_order_relaxed);
+	}
+
+	uint64_t sum() const
+	{
+		return m_sum.load(std::memory_order_relaxed);
+	}
+
+	uint64_t min() const
+	{
+		return count() == 0 ? 0 : m_min.load(std::memory_order_relaxed);
+	}
+
+	uint64_t max() const
+	{
+		return m_max.load(std::memory_order_relaxed);
+	}
+
+	double mean() const
+	{
+		const uint64_t n = count();
+		return n == 0 ? 0.0 : (double)sum() / n;
+	}
+
+	// Value at the given percentile in [0, 100], accurate to the bucket precision
+	uint64_t percentile(double p) const
+	{
+		const uint64_t n = count();
+		if (n == 0) return 0;
+
+		const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(p / 100.0 * n + 0.5));
+
+		uint64_t seen = 0;
+		for (uint32_t idx = 0; idx < BUCKETS; idx++)
+		{
+			seen += buckets[idx].load(std::memory_order_relaxed);
+			if (seen >= rank)
+			{
+				return std::min(max(), bucket_low(idx) + (bucket_width(idx) - 1) / 2);
+			}
+		}
+		return max();
+	}
+
+	void merge(const latency_histogram& other)
+	{
+		for (uint32_t idx = 0; idx < BUCKETS; idx++)
+		{
+			const uint64_t n = other.buckets[idx].load(std::memory_order_relaxed);
+			if (n > 0) buckets[idx].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		if (other.count() == 0) return;
+
+		m_count.fetch_add(other.count(), std::memory_order_relaxed);
+		m_sum.fetch_add(other.sum(), std::memory_order_relaxed);
+
+		uint64_t prev = m_min.load(std::memory_order_relaxed);
+		while (other.min() < prev && !m_min.compare_exchange_weak(prev, other.min(), std::memory_order_relaxed));
+
+		prev = m_max.load(std::memory_order_relaxed);
+		while (other.max() > prev && !m_max.compare_exchange_weak(prev, other.max(), std::memory_order_relaxed));
+	}
+
+	void reset()
+	{
+		for (std::atomic<uint64_t>& bucket : buckets)
+		{
+			bucket.store(0, std::memory_order_relaxed);
+		}
+
+		m_count.store(0, std::memory_order_relaxed);
+		m_sum.store(0, std::memory_order_relaxed);
+		m_min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+		m_max.store(0, std::memory_order_relaxed);
+	}
+
+protected:
+
+	static uint32_t most_significant_bit(uint64_t value)
+	{
+		uint32_t msb = 0;
+		for (uint32_t step = 32; step > 0; step /= 2)
+		{
+			if (value >> step)
+			{
+				value >>= step;
+				msb += step;
+			}
+		}
+		return msb;
+	}
+
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets = {};
+
+	std::atomic<uint64_t> m_count = 0;
+	std::atomic<uint64_t> m_sum = 0;
+	std::atomic<uint64_t> m_min = std::numeric_limits<uint64_t>::max();
+	std::atomic<uint64_t> m_max = 0;
+};
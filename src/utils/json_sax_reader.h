@@ -0,0 +1,353 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+
+// Reusable JSON reader driving a SAX handler with the json::sax_parse interface.
+//
+// json::sax_parse builds a new lexer, token buffer and nesting stack for every document. A reader
+// keeps them between documents, so once they have grown to the largest document it parses nothing
+// is allocated. Strings and keys are handed to the handler in the reused token buffer. A syntax
+// error ends the parse and is reported to handler.parse_error(position, message). Strings are not
+// checked for valid UTF-8.
+class json_sax_reader
+{
+public:
+
+	// False when the document is malformed or a callback stopped the parse
+	template <class Handler>
+	bool parse(std::string_view document, Handler& handler)
+	{
+		input = document;
+		pos = 0;
+		stack.clear();
+
+		while (true)
+		{
+			// A value is expected
+			skip_whitespace();
+			if (pos == input.size()) return fail(handler, pos, "unexpected end of input");
+
+			bool done = true;
+
+			switch (input[pos])
+			{
+			case '{':
+			{
+				pos++;
+				if (!handler.start_object(std::size_t(-1))) return false;
+
+				skip_whitespace();
+				if (pos < input.size() && input[pos] == '}')
+				{
+					pos++;
+					if (!handler.end_object()) return false;
+					break;
+				}
+
+				stack.push_back(OBJECT);
+				if (!read_key(handler)) return false;
+				done = false;
+			} break;
+			case '[':
+			{
+				pos++;
+				if (!handler.start_array(std::size_t(-1))) return false;
+
+				skip_whitespace();
+				if (pos < input.size() && input[pos] == ']')
+				{
+					pos++;
+					if (!handler.end_array()) return false;
+					break;
+				}
+
+				stack.push_back(ARRAY);
+				done = false;
+			} break;
+			case '"':
+			{
+				if (!read_string(handler)) return false;
+				if (!handler.string(token)) return false;
+			} break;
+			case 't':
+			{
+				if (!read_literal("true", handler)) return false;
+				if (!handler.boolean(true)) return false;
+			} break;
+			case 'f':
+			{
+				if (!read_literal("false", handler)) return false;
+				if (!handler.boolean(false)) return false;
+			} break;
+			case 'n':
+			{
+				if (!read_literal("null", handler)) return false;
+				if (!handler.null()) return false;
+			} break;
+			default:
+			{
+				if (!read_number(handler)) return false;
+			} break;
+			}
+
+			// The value is complete, close the containers it completes
+			while (done)
+			{
+				skip_whitespace();
+
+				if (stack.empty())
+				{
+					if (pos != input.size()) return fail(handler, pos, "unexpected characters after the document");
+					return true;
+				}
+
+				if (pos == input.size()) return fail(handler, pos, "unexpected end of input");
+
+				const char c = input[pos++];
+
+				if (c == ',')
+				{
+					if (stack.back() == OBJECT && !read_key(handler)) return false;
+					done = false;
+				}
+				else if (c == '}' && stack.back() == OBJECT)
+				{
+					stack.pop_back();
+					if (!handler.end_object()) return false;
+				}
+				else if (c == ']' && stack.back() == ARRAY)
+				{
+					stack.pop_back();
+					if (!handler.end_array()) return false;
+				}
+				else
+				{
+					return fail(handler, pos - 1, stack.back() == OBJECT ? "expected ',' or '}'" : "expected ',' or ']'");
+				}
+			}
+		}
+	}
+
+protected:
+
+	enum container : uint8_t
+	{
+		OBJECT,
+		ARRAY
+	};
+
+	template <class Handler>
+	static bool fail(Handler& handler, size_t position, std::string_view message)
+	{
+		handler.parse_error(position, message);
+		return false;
+	}
+
+	void skip_whitespace()
+	{
+		while (pos < input.size() && (input[pos] == ' ' || input[pos] == '\t' || input[pos] == '\n' || input[pos] == '\r')) pos++;
+	}
+
+	// Reads "key": and hands the key over
+	template <class Handler>
+	bool read_key(Handler& handler)
+	{
+		skip_whitespace();
+		if (pos == input.size() || input[pos] != '"') return fail(handler, pos, "expected a key");
+
+		if (!read_string(handler)) return false;
+		if (!handler.key(token)) return false;
+
+		skip_whitespace();
+		if (pos == input.size() || input[pos] != ':') return fail(handler, pos, "expected ':'");
+		pos++;
+
+		return true;
+	}
+
+	template <class Handler>
+	bool read_literal(std::string_view literal, Handler& handler)
+	{
+		if (input.substr(pos, literal.size()) != literal) return fail(handler, pos, "invalid literal");
+
+		pos += literal.size();
+		return true;
+	}
+
+	// Reads a string into token, pos is at the opening quote
+	template <class Handler>
+	bool read_string(Handler& handler)
+	{
+		token.clear();
+		pos++;
+
+		while (true)
+		{
+			// Plain runs are appended at once
+			const size_t start = pos;
+			while (pos < input.size() && input[pos] != '"' && input[pos] != '\\' && (unsigned char)input[pos] >= 0x20) pos++;
+			token.append(input.data() + start, pos - start);
+
+			if (pos == input.size()) return fail(handler, pos, "unterminated string");
+
+			const char c = input[pos++];
+
+			if (c == '"') return true;
+			if (c != '\\') return fail(handler, pos - 1, "control character in a string");
+
+			if (pos == input.size()) return fail(handler, pos, "unterminated string");
+
+			switch (input[pos++])
+			{
+			case '"': token.push_back('"'); break;
+			case '\\': token.push_back('\\'); break;
+			case '/': token.push_back('/'); break;
+			case 'b': token.push_back('\b'); break;
+			case 'f': token.push_back('\f'); break;
+			case 'n': token.push_back('\n'); break;
+			case 'r': token.push_back('\r'); break;
+			case 't': token.push_back('\t'); break;
+			case 'u':
+			{
+				uint32_t codepoint;
+				if (!read_hex4(codepoint)) return fail(handler, pos, "invalid \\u escape");
+
+				if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+				{
+					uint32_t low;
+					if (input.substr(pos, 2) != "\\u") return fail(handler, pos, "unpaired surrogate");
+					pos += 2;
+					if (!read_hex4(low) || low < 0xDC00 || low > 0xDFFF) return fail(handler, pos, "unpaired surrogate");
+
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+				{
+					return fail(handler, pos, "unpaired surrogate");
+				}
+
+				append_utf8(codepoint);
+			} break;
+			default: return fail(handler, pos - 1, "invalid escape");
+			}
+		}
+	}
+
+	bool read_hex4(uint32_t& val)
+	{
+		if (input.size() - pos < 4) return false;
+
+		val = 0;
+		for (size_t idx = 0; idx < 4; idx++)
+		{
+			const char c = input[pos++];
+			val <<= 4;
+
+			if (c >= '0' && c <= '9') val |= c - '0';
+			else if (c >= 'a' && c <= 'f') val |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') val |= c - 'A' + 10;
+			else return false;
+		}
+		return true;
+	}
+
+	void append_utf8(uint32_t codepoint)
+	{
+		if (codepoint < 0x80)
+		{
+			token.push_back((char)codepoint);
+		}
+		else if (codepoint < 0x800)
+		{
+			token.push_back((char)(0xC0 | (codepoint >> 6)));
+			token.push_back((char)(0x80 | (codepoint & 0x3F)));
+		}
+		else if (codepoint < 0x10000)
+		{
+			token.push_back((char)(0xE0 | (codepoint >> 12)));
+			token.push_back((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+			token.push_back((char)(0x80 | (codepoint & 0x3F)));
+		}
+		else
+		{
+			token.push_back((char)(0xF0 | (codepoint >> 18)));
+			token.push_back((char)(0x80 | ((codepoint >> 12) & 0x3F)));
+			token.push_back((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+			token.push_back((char)(0x80 | (codepoint & 0x3F)));
+		}
+	}
+
+	size_t skip_digits()
+	{
+		const size_t start = pos;
+		while (pos < input.size() && input[pos] >= '0' && input[pos] <= '9') pos++;
+		return pos - start;
+	}
+
+	// Integers that fit are reported as number_unsigned, or number_integer when negative, like json::sax_parse does
+	template <class Handler>
+	bool read_number(Handler& handler)
+	{
+		const size_t start = pos;
+
+		const bool negative = input[pos] == '-';
+		if (negative) pos++;
+
+		const size_t int_start = pos;
+		const size_t int_digits = skip_digits();
+		if (int_digits == 0) return fail(handler, start, "invalid value");
+		if (int_digits > 1 && input[int_start] == '0') return fail(handler, start, "leading zero in a number");
+
+		bool is_float = false;
+
+		if (pos < input.size() && input[pos] == '.')
+		{
+			pos++;
+			if (skip_digits() == 0) return fail(handler, pos, "expected a digit after '.'");
+			is_float = true;
+		}
+
+		if (pos < input.size() && (input[pos] == 'e' || input[pos] == 'E'))
+		{
+			pos++;
+			if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) pos++;
+			if (skip_digits() == 0) return fail(handler, pos, "expected a digit in the exponent");
+			is_float = true;
+		}
+
+		token.assign(input.data() + start, pos - start);
+
+		if (!is_float)
+		{
+			uint64_t val = 0;
+			bool overflow = false;
+
+			for (size_t idx = int_start; idx < pos; idx++)
+			{
+				const uint64_t digit = input[idx] - '0';
+				if (val > (UINT64_MAX - digit) / 10) overflow = true;
+				val = val * 10 + digit;
+			}
+
+			if (!overflow && !negative) return handler.number_unsigned(val);
+			if (!overflow && val <= uint64_t(INT64_MAX) + 1) return handler.number_integer(val == uint64_t(INT64_MAX) + 1 ? INT64_MIN : -(int64_t)val);
+		}
+
+		const double val = std::strtod(token.c_str(), nullptr);
+		if (!std::isfinite(val)) return fail(handler, start, "number overflow");
+
+		return handler.number_float(val, token);
+	}
+
+	std::string_view input;
+	size_t pos = 0;
+
+	std::string token;
+	std::vector<container> stack;
+};
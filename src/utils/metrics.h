@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <src/utils/histogram.h>
+#include <src/utils/network/network_stats.h>
+
+
+// Client performance figures shared between the game loop, the solver and the render thread.
+//
+// Every metric keeps its latest value and a histogram of all values. Recording is a few relaxed
+// atomics and reading never blocks a writer, so the HUD reads it from the render thread while the
+// game loop records into it, and nothing changes for the game loop when nobody reads.
+class metrics_registry
+{
+public:
+
+	enum metric : uint8_t
+	{
+		// Nanoseconds
+		FRAME_TIME,
+		L1_PARSE,
+		SOLVER_UPGRADES,
+		SOLVER_STATES,
+		SOLVER_TURNS,
+		SOLVER_COLLISIONS,
+		SOLVER_TOTAL,
+
+		// Heap allocations of one solver tick, see alloc_stats
+		TICK_ALLOCATIONS,
+
+		NUM_METRICS
+	};
+
+	static const char* name(metric m)
+	{
+		switch (m)
+		{
+		case FRAME_TIME: return "frame";
+		case L1_PARSE: return "L1 parse";
+		case SOLVER_UPGRADES: return "upgrades";
+		case SOLVER_STATES: return "states";
+		case SOLVER_TURNS: return "turns";
+		case SOLVER_COLLISIONS: return "collisions";
+		case SOLVER_TOTAL: return "solver";
+		case TICK_ALLOCATIONS: return "allocations";
+		default: return "unknown";
+		}
+	}
+
+	// Records the time from construction to destruction, in nanoseconds
+	class scoped_timer
+	{
+	public:
+
+		scoped_timer(metrics_registry* registry, metric m)
+			: registry(registry), m(m), start(std::chrono::steady_clock::now()) {}
+
+		~scoped_timer()
+		{
+			if (registry != nullptr) registry->record(m, std::chrono::steady_clock::now() - start);
+		}
+
+		scoped_timer(const scoped_timer&) = delete;
+		scoped_timer& operator=(const scoped_timer&) = delete;
+
+	protected:
+
+		metrics_registry* registry;
+		const metric m;
+		const std::chrono::steady_clock::time_point start;
+	};
+
+	// Round trips per Action, owned by the connector, may stay null
+	const network_stats* network = nullptr;
+
+	// Time the server gives for a turn, the remaining budget is counted from begin_turn()
+	std::chrono::milliseconds turn_budget{ 10000 };
+
+	void record(metric m, uint64_t value)
+	{
+		latest[m].store(value, std::memory_order_relaxed);
+		histograms[m].record(value);
+	}
+
+	void record(metric m, std::chrono::nanoseconds value)
+	{
+		record(m, (uint64_t)value.count());
+	}
+
+	uint64_t last(metric m) const
+	{
+		return latest[m].load(std::memory_order_relaxed);
+	}
+
+	const latency_histogram& histogram(metric m) const
+	{
+		return histograms[m];
+	}
+
+	// Called when the state of a new tick was read, the turn budget starts running
+	void begin_turn()
+	{
+		turn_start.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+	}
+
+	// Negative once the budget is used up, the full budget before the first turn
+	std::chrono::milliseconds remaining_turn_budget() const
+	{
+		const auto start = turn_start.load(std::memory_order_relaxed);
+		if (start == 0) return turn_budget;
+
+		const auto elapsed = std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(start);
+		return turn_budget - std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+	}
+
+protected:
+
+	std::array<std::atomic<uint64_t>, NUM_METRICS> latest = {};
+	std::array<latency_histogram, NUM_METRICS> histograms;
+
+	std::atomic<std::chrono::steady_clock::rep> turn_start{ 0 };
+};
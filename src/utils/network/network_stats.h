@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <iomanip>
+
+#include <src/utils/histogram.h>
+#include <src/utils/Logging.h>
+
+
+// Round trip latency per Action plus packet and byte counters.
+// Lock-free to record into, so one instance may be shared by every connector of the process.
+class network_stats
+{
+public:
+
+	// Covers every server_connector::Action code
+	static constexpr size_t MAX_ACTION = 16;
+
+	static const char* action_name(uint32_t action)
+	{
+		switch (action)
+		{
+		case 1: return "LOGIN";
+		case 2: return "LOGOUT";
+		case 3: return "MOVE";
+		case 4: return "UPGRADE";
+		case 5: return "TURN";
+		case 6: return "PLAYER";
+		case 7: return "GAMES";
+		case 10: return "MAP";
+		default: return "UNKNOWN";
+		}
+	}
+
+	void record_sent(size_t bytes)
+	{
+		packets_sent.fetch_add(1, std::memory_order_relaxed);
+		bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	void record_received(uint32_t action, size_t bytes, std::chrono::nanoseconds rtt)
+	{
+		packets_received.fetch_add(1, std::memory_order_relaxed);
+		bytes_received.fetch_add(bytes, std::memory_order_relaxed);
+
+		rtt_histogram(action).record(rtt.count());
+	}
+
+	// Nanoseconds from sending a request until its response is read
+	latency_histogram& rtt_histogram(uint32_t action)
+	{
+		return rtt[action < MAX_ACTION ? action : 0];
+	}
+
+	const latency_histogram& rtt_histogram(uint32_t action) const
+	{
+		return rtt[action < MAX_ACTION ? action : 0];
+	}
+
+	void reset()
+	{
+		for (latency_histogram& histogram : rtt)
+		{
+			histogram.reset();
+		}
+
+		packets_sent.store(0, std::memory_order_relaxed);
+		packets_received.store(0, std::memory_order_relaxed);
+		bytes_sent.store(0, std::memory_order_relaxed);
+		bytes_received.store(0, std::memory_order_relaxed);
+	}
+
+	void dump(std::ostream& out) const
+	{
+		out << "network_stats: sent " << packets_sent << " packets / " << bytes_sent << " bytes, "
+			<< "received " << packets_received << " packets / " << bytes_received << " bytes" << std::endl;
+
+		out << "  " << std::left << std::setw(8) << "action" << std::right
+			<< std::setw(8) << "count"
+			<< std::setw(10) << "min"
+			<< std::setw(10) << "p50"
+			<< std::setw(10) << "p90"
+			<< std::setw(10) << "p99"
+			<< std::setw(10) << "max"
+			<< std::setw(10) << "mean" << "  (us)" << std::endl;
+
+		for (uint32_t action = 0; action < MAX_ACTION; action++)
+		{
+			const latency_histogram& histogram = rtt[action];
+			if (histogram.count() == 0) continue;
+
+			out << "  " << std::left << std::setw(8) << action_name(action) << std::right
+				<< std::setw(8) << histogram.count()
+				<< std::setw(10) << histogram.min() / 1000
+				<< std::setw(10) << histogram.percentile(50) / 1000
+				<< std::setw(10) << histogram.percentile(90) / 1000
+				<< std::setw(10) << histogram.percentile(99) / 1000
+				<< std::setw(10) << histogram.max() / 1000
+				<< std::setw(10) << (uint64_t)histogram.mean() / 1000 << std::endl;
+		}
+	}
+
+	std::atomic<uint64_t> packets_sent = 0;
+	std::atomic<uint64_t> packets_received = 0;
+	std::atomic<uint64_t> bytes_sent = 0;
+	std::atomic<uint64_t> bytes_received = 0;
+
+protected:
+
+	std::array<latency_histogram, MAX_ACTION> rtt;
+};
+
+
+// Dumps the stats from a background thread at a fixed interval, and once more when destroyed
+class network_stats_reporter
+{
+public:
+
+	network_stats_reporter(const network_stats& stats, std::chrono::milliseconds interval, std::ostream& out = std::cout)
+		: stats(stats), interval(interval), out(out), thread(&network_stats_reporter::run, this) {}
+
+	~network_stats_reporter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+
+		thread.join();
+
+		stats.dump(out);
+	}
+
+	network_stats_reporter(const network_stats_reporter&) = delete;
+	network_stats_reporter& operator=(const network_stats_reporter&) = delete;
+
+protected:
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (!cv.wait_for(lock, interval, [this]() { return stopping; }))
+		{
+			stats.dump(out);
+		}
+	}
+
+	const network_stats& stats;
+	const std::chrono::milliseconds interval;
+	std::ostream& out;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+
+	std::thread thread;
+};
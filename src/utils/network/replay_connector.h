@@ -0,0 +1,119 @@
+#pragma once
+
+#include <deque>
+
+#include <src/utils/network/server_connector.h>
+#include <src/utils/network/traffic_capture.h>
+
+
+// Feeds a captured session back to the client without any network.
+//
+// Requests are matched to the captured ones by Action, in order. Requests the client no longer
+// sends are skipped together with their responses (but never past a Turn), and requests missing
+// from the capture are answered with an empty OKEY, so replay survives small solver changes.
+// Once the capture runs out, e.g. the captured session was killed, every request is answered with
+// END_OF_CAPTURE, which read_packet throws like a server error.
+class replay_connector : public server_connector
+{
+public:
+
+	static constexpr Result END_OF_CAPTURE = (Result)UINT32_MAX;
+
+	replay_connector(boost::asio::io_service& m_io, const std::string& path)
+		: server_connector(m_io), replay(path)
+	{
+		// Responses arrive in request order
+		size_t next_response = 0;
+
+		for (const traffic_replay::packet& packet : replay.packets)
+		{
+			if (packet.direction == traffic_replay::Direction::OUTGOING)
+			{
+				exchanges.push_back({ (Action)packet.code, nullptr });
+			}
+			else if (next_response < exchanges.size())
+			{
+				exchanges[next_response++].response = &packet;
+			}
+			else
+			{
+				LOG_1("replay_connector: Unexpected response in capture, ignored");
+			}
+		}
+
+		LOG_2("replay_connector: " << exchanges.size() << " exchanges loaded");
+	}
+
+	// Number of requests that did not match the capture
+	size_t diverged() const
+	{
+		return m_diverged;
+	}
+
+	bool finished() const
+	{
+		return next_exchange >= exchanges.size();
+	}
+
+protected:
+
+	struct exchange
+	{
+		Action action;
+		const traffic_replay::packet* response;
+	};
+
+	void _write(const std::string& packet, bool async) override
+	{
+		BinCharIStream parser(packet.c_str());
+		const Action action = (Action)boost::endian::little_to_native(parser.read<uint32_t>());
+
+		if (finished())
+		{
+			LOG_2("replay_connector: Request " << action << " after the end of the capture");
+
+			responses.emplace_back(END_OF_CAPTURE, "");
+			return;
+		}
+
+		for (size_t idx = next_exchange; idx < exchanges.size(); idx++)
+		{
+			const exchange& ex = exchanges[idx];
+
+			if (ex.action == action)
+			{
+				if (idx != next_exchange) m_diverged++;
+				next_exchange = idx + 1;
+
+				// Only the last request of a capture cut short has no response
+				if (ex.response != nullptr) responses.emplace_back((Result)ex.response->code, std::string(ex.response->payload));
+				else responses.emplace_back(END_OF_CAPTURE, "");
+				return;
+			}
+
+			if (ex.action == Action::TURN) break;
+		}
+
+		LOG_1("replay_connector: Request " << action << " is not in the capture, answering OKEY");
+
+		m_diverged++;
+		responses.emplace_back(Result::OKEY, "");
+	}
+
+	std::pair<Result, std::string> _read() override
+	{
+		if (responses.empty()) throw std::runtime_error("replay_connector: Read without a pending request");
+
+		std::pair<Result, std::string> val = std::move(responses.front());
+		responses.pop_front();
+		return val;
+	}
+
+	traffic_replay replay;
+
+	std::vector<exchange> exchanges;
+	size_t next_exchange = 0;
+	size_t m_diverged = 0;
+
+	std::deque<std::pair<Result, std::string>> responses;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <optional>
+#include <deque>
+#include <chrono>
 
 #include <nlohmann/json.hpp>
 using nlohmann::json;
@@ -8,6 +10,8 @@ using nlohmann::json;
 #include <boost/endian/conversion.hpp>
 
 #include <src/utils/network/tcp_connector.h>
+#include <src/utils/network/traffic_capture.h>
+#include <src/utils/network/network_stats.h>
 #include <src/Types.h>
 
 #include <src/utils/bincharstream.h>
@@ -30,6 +34,14 @@ public:
 	server_connector(boost::asio::io_service& m_io)
 		: tcp_connector(m_io) {}
 
+	CLASS_VIRTUAL_DESTRUCTOR(server_connector);
+
+	// Optional recorder of every packet sent and received through this connector
+	traffic_capture* capture = nullptr;
+
+	// Optional latency and throughput counters, may be shared between connectors
+	network_stats* stats = nullptr;
+
 	void connect(const std::string& addr, const std::string& port)
 	{
 		return tcp_connector::connect(addr, port);
@@ -104,20 +116,98 @@ public:
     {
         LOG_2("server_connector::read_packet: Reading packet...");
 
-        const auto header = _read_header();
-
-        const std::string data = tcp_connector::read_until_size(header.second);
+        const auto packet = _read();
 
         LOG_3("------------------------- BEGIN -------------------------");
-        LOG_3("Action:" << header.first << " Size:" << header.second);
-        LOG_3(data);
+        LOG_3("Action:" << packet.first << " Size:" << packet.second.size());
+        LOG_3(packet.second);
         LOG_3("-------------------------  END  -------------------------");
 
-        if (header.first != Result::OKEY) throw header.first;
+        if (capture != nullptr) capture->record(traffic_capture::Direction::INCOMING, packet.first, packet.second);
+
+        if (!m_inflight.empty())
+        {
+            if (stats != nullptr)
+            {
+                const inflight_request& request = m_inflight.front();
+                stats->record_received(request.action, 8 + packet.second.size(), std::chrono::steady_clock::now() - request.sent);
+            }
+
+            m_inflight.pop_front();
+        }
+
+        if (packet.first != Result::OKEY) throw packet.first;
+
+        return packet;
+    }
 
-        return std::make_pair(header.first, data);
+    // Reads and discards responses to requests sent without waiting for an answer (moves, upgrades)
+    void read_pending()
+    {
+        while (!m_inflight.empty())
+        {
+            try
+            {
+                read_packet();
+            }
+            catch (Result err)
+            {
+                LOG_1("server_connector::read_pending: Request rejected, code " << err);
+            }
+        }
     }
 
+protected:
+
+    void _send(const std::string& packet)
+    {
+        _record_outgoing(packet);
+        _write(packet, false);
+    }
+
+    void _async_send(const std::string& packet)
+    {
+        _record_outgoing(packet);
+        _write(packet, true);
+    }
+
+    void _record_outgoing(const std::string& packet)
+    {
+        BinCharIStream parser(packet.c_str());
+        const Action action = (Action)boost::endian::little_to_native(parser.read<uint32_t>());
+
+        if (capture != nullptr) capture->record(traffic_capture::Direction::OUTGOING, action, std::string_view(packet).substr(8));
+        if (stats != nullptr) stats->record_sent(packet.size());
+
+        m_inflight.push_back({ action, std::chrono::steady_clock::now() });
+    }
+
+    //---- Transport, overridden by connectors that do not talk to a socket ----//
+
+    virtual void _write(const std::string& packet, bool async)
+    {
+        if (async) tcp_connector::async_send(packet);
+        else tcp_connector::send(packet);
+    }
+
+    virtual std::pair<Result, std::string> _read()
+    {
+        const auto header = _read_header();
+
+        return std::make_pair(header.first, tcp_connector::read_until_size(header.second));
+    }
+
+    struct inflight_request
+    {
+        Action action;
+        std::chrono::steady_clock::time_point sent;
+    };
+
+    // Sent requests whose responses have not been read yet, in sending order
+    std::deque<inflight_request> m_inflight;
+
+public:
+
 
 
     //------------------------------ Login ------------------------------//
@@ -147,12 +237,12 @@ public:
 
     void send_Login(const Login& val)
     {
-        return tcp_connector::send(Login::encodeJSON(val));
+        return _send(Login::encodeJSON(val));
     }
 
     void async_send_Login(const Login& val)
     {
-        return tcp_connector::async_send(Login::encodeJSON(val));
+        return _async_send(Login::encodeJSON(val));
     }
 
     //------------------------------ Player ------------------------------//
@@ -167,12 +257,12 @@ public:
 
     void send_Player()
     {
-        return tcp_connector::send(Player::encodeJSON());
+        return _send(Player::encodeJSON());
     }
 
     void async_send_Player()
     {
-        return tcp_connector::async_send(Player::encodeJSON());
+        return _async_send(Player::encodeJSON());
     }
 
     //------------------------------ Logout ------------------------------//
@@ -187,12 +277,12 @@ public:
 
     void send_Logout()
     {
-        return tcp_connector::send(Logout::encodeJSON());
+        return _send(Logout::encodeJSON());
     }
 
     void async_send_Logout()
     {
-        return tcp_connector::async_send(Logout::encodeJSON());
+        return _async_send(Logout::encodeJSON());
     }
 
     //------------------------------ Map ------------------------------//
@@ -213,12 +303,12 @@ public:
 
     void send_Map(const Map& val)
     {
-        return tcp_connector::send(Map::encodeJSON(val));
+        return _send(Map::encodeJSON(val));
     }
 
     void async_send_Map(const Map& val)
     {
-        return tcp_connector::async_send(Map::encodeJSON(val));
+        return _async_send(Map::encodeJSON(val));
     }
 
     //------------------------------ Move ------------------------------//
@@ -243,12 +333,12 @@ public:
 
     void send_Move(const Move& val)
     {
-        return tcp_connector::send(Move::encodeJSON(val));
+        return _send(Move::encodeJSON(val));
     }
 
     void async_send_Move(const Move& val)
     {
-        return tcp_connector::async_send(Move::encodeJSON(val));
+        return _async_send(Move::encodeJSON(val));
     }
 
     //------------------------------ Upgrade ------------------------------//
@@ -271,12 +361,12 @@ public:
 
     void send_Upgrade(const Upgrade& val)
     {
-        return tcp_connector::send(Upgrade::encodeJSON(val));
+        return _send(Upgrade::encodeJSON(val));
     }
 
     void async_send_Upgrade(const Upgrade& val)
     {
-        return tcp_connector::async_send(Upgrade::encodeJSON(val));
+        return _async_send(Upgrade::encodeJSON(val));
     }
 
     //------------------------------ Turn ------------------------------//
@@ -291,12 +381,12 @@ public:
 
     void send_Turn()
     {
-        return tcp_connector::send(Turn::encodeJSON());
+        return _send(Turn::encodeJSON());
     }
 
     void async_send_Turn()
     {
-        return tcp_connector::async_send(Turn::encodeJSON());
+        return _async_send(Turn::encodeJSON());
     }
 
     //------------------------------ Games ------------------------------//
@@ -311,12 +401,12 @@ public:
 
     void send_Games()
     {
-        return tcp_connector::send(Games::encodeJSON());
+        return _send(Games::encodeJSON());
     }
 
     void async_send_Games()
     {
-        return tcp_connector::async_send(Games::encodeJSON());
+        return _async_send(Games::encodeJSON());
     }
 
 };
\ No newline at end of file
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <src/utils/ClassDefines.h>
+#include <src/utils/Logging.h>
+
+
+// Binary capture of the server traffic.
+//
+// File layout (native byte order, all records 8-byte aligned):
+//   traffic_capture_header
+//   { traffic_capture_record, payload padded to 8 bytes } * records
+//
+// The header is updated after every record, so a capture cut short by a crash stays readable.
+namespace traffic_capture_format {
+
+	constexpr char MAGIC[8] = { 'T', '6', 'C', 'A', 'P', 0, 0, 0 };
+	constexpr uint32_t VERSION = 1;
+
+	enum Direction : uint32_t
+	{
+		OUTGOING = 0,
+		INCOMING = 1
+	};
+
+	struct header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+
+		// Wall clock time of the capture start, nanoseconds since epoch
+		uint64_t start_time_ns;
+
+		// Bytes in use including this header
+		uint64_t size;
+		uint64_t records;
+	};
+
+	struct record
+	{
+		// Steady clock time since the capture start
+		uint64_t time_ns;
+
+		// server_connector::Action for outgoing packets, server_connector::Result for incoming ones
+		uint32_t code;
+		uint32_t direction;
+
+		uint32_t length;
+		uint32_t reserved;
+	};
+
+	inline size_t padded(size_t size)
+	{
+		return (size + 7) & ~size_t(7);
+	}
+}
+
+
+// Appends packets to a memory-mapped capture file. One instance per connector, not thread-safe.
+class traffic_capture
+{
+public:
+
+	using Direction = traffic_capture_format::Direction;
+
+	static constexpr size_t GROW_SIZE = 1 << 20;
+
+	traffic_capture(const std::string& path)
+		: path(path), start(std::chrono::steady_clock::now())
+	{
+		const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+		if (!parent.empty()) std::filesystem::create_directories(parent);
+
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) throw std::runtime_error("Failed to create traffic capture: " + path);
+		}
+
+		remap(GROW_SIZE);
+
+		traffic_capture_format::header& h = header();
+		std::memcpy(h.magic, traffic_capture_format::MAGIC, sizeof(h.magic));
+		h.version = traffic_capture_format::VERSION;
+		h.reserved = 0;
+		h.start_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		h.size = sizeof(traffic_capture_format::header);
+		h.records = 0;
+	}
+
+	~traffic_capture()
+	{
+		const uint64_t size = header().size;
+
+		region = boost::interprocess::mapped_region();
+		mapping = boost::interprocess::file_mapping();
+
+		// Drop the unused tail of the last grow step
+		std::error_code ec;
+		std::filesystem::resize_file(path, size, ec);
+	}
+
+	traffic_capture(const traffic_capture&) = delete;
+	traffic_capture& operator=(const traffic_capture&) = delete;
+
+	void record(Direction direction, uint32_t code, std::string_view payload)
+	{
+		const size_t offset = header().size;
+		const size_t total = sizeof(traffic_capture_format::record) + traffic_capture_format::padded(payload.size());
+
+		if (offset + total > region.get_size())
+		{
+			remap(std::max(region.get_size() * 2, offset + total + GROW_SIZE));
+		}
+
+		char* dest = static_cast<char*>(region.get_address()) + offset;
+
+		traffic_capture_format::record r;
+		r.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		r.code = code;
+		r.direction = direction;
+		r.length = (uint32_t)payload.size();
+		r.reserved = 0;
+
+		std::memcpy(dest, &r, sizeof(r));
+		std::memcpy(dest + sizeof(r), payload.data(), payload.size());
+		std::memset(dest + sizeof(r) + payload.size(), 0, total - sizeof(r) - payload.size());
+
+		header().size += total;
+		header().records++;
+	}
+
+	uint64_t records()
+	{
+		return header().records;
+	}
+
+protected:
+
+	traffic_capture_format::header& header()
+	{
+		return *static_cast<traffic_capture_format::header*>(region.get_address());
+	}
+
+	void remap(size_t size)
+	{
+		LOG_2("traffic_capture::remap: Growing " << path << " to " << size << " bytes");
+
+		region = boost::interprocess::mapped_region();
+		mapping = boost::interprocess::file_mapping();
+
+		std::filesystem::resize_file(path, size);
+
+		mapping = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_write);
+		region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_write);
+	}
+
+	const std::string path;
+	const std::chrono::steady_clock::time_point start;
+
+	boost::interprocess::file_mapping mapping;
+	boost::interprocess::mapped_region region;
+};
+
+
+// Read-only view of a capture file. Payloads point straight into the mapping.
+class traffic_replay
+{
+public:
+
+	using Direction = traffic_capture_format::Direction;
+
+	struct packet
+	{
+		uint64_t time_ns;
+		uint32_t code;
+		Direction direction;
+		std::string_view payload;
+	};
+
+	traffic_replay(const std::string& path)
+		: mapping(path.c_str(), boost::interprocess::read_only),
+		region(mapping, boost::interprocess::read_only)
+	{
+		const char* base = static_cast<const char*>(region.get_address());
+
+		if (region.get_size() < sizeof(traffic_capture_format::header)) throw std::runtime_error("Traffic capture is too short: " + path);
+
+		traffic_capture_format::header h;
+		std::memcpy(&h, base, sizeof(h));
+
+		if (std::memcmp(h.magic, traffic_capture_format::MAGIC, sizeof(h.magic)) != 0) throw std::runtime_error("Not a traffic capture: " + path);
+		if (h.version != traffic_capture_format::VERSION) throw std::runtime_error("Unsupported traffic capture version: " + path);
+		if (h.size > region.get_size()) throw std::runtime_error("Traffic capture is truncated: " + path);
+
+		start_time_ns = h.start_time_ns;
+		packets.reserve(h.records);
+
+		size_t offset = sizeof(h);
+		while (offset + sizeof(traffic_capture_format::record) <= h.size)
+		{
+			traffic_capture_format::record r;
+			std::memcpy(&r, base + offset, sizeof(r));
+			offset += sizeof(r);
+
+			if (offset + r.length > h.size) throw std::runtime_error("Traffic capture record is truncated: " + path);
+
+			packets.push_back({ r.time_ns, r.code, (Direction)r.direction, std::string_view(base + offset, r.length) });
+			offset += traffic_capture_format::padded(r.length);
+		}
+
+		LOG_2("traffic_replay: Loaded " << packets.size() << " packets from " << path);
+	}
+
+	uint64_t start_time_ns;
+	std::vector<packet> packets;
+
+protected:
+
+	boost::interprocess::file_mapping mapping;
+	boost::interprocess::mapped_region region;
+};
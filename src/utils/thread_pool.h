@@ -0,0 +1,179 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <memory>
+
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pops its own tasks LIFO and steals from the others FIFO when idle.
+// Queued tasks are counted by an atomic, the idle mutex is only taken to sleep and to wake sleepers.
+class thread_pool
+{
+public:
+
+	using task_t = std::function<void()>;
+
+	thread_pool(size_t num_threads = std::thread::hardware_concurrency())
+		: queues(std::max<size_t>(num_threads, 1))
+	{
+		for (size_t idx = 0; idx < queues.size(); idx++)
+		{
+			queues[idx] = std::make_unique<worker_queue>();
+		}
+
+		for (size_t idx = 0; idx < queues.size(); idx++)
+		{
+			workers.emplace_back(&thread_pool::worker_loop, this, idx);
+		}
+	}
+
+	~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			stopping = true;
+		}
+		idle_cv.notify_all();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	size_t size() const
+	{
+		return workers.size();
+	}
+
+	template <class Func>
+	auto submit(Func f) -> std::future<decltype(f())>
+	{
+		using result_t = decltype(f());
+
+		auto task = std::make_shared<std::packaged_task<result_t()>>(std::move(f));
+		std::future<result_t> result = task->get_future();
+
+		push([task]() { (*task)(); });
+
+		return result;
+	}
+
+protected:
+
+	struct worker_queue
+	{
+		std::mutex mutex;
+		std::deque<task_t> tasks;
+	};
+
+	// Index of the pool worker running on this thread, or -1 for foreign threads
+	static size_t& current_worker()
+	{
+		static thread_local size_t idx = -1;
+		return idx;
+	}
+
+	void push(task_t task)
+	{
+		size_t idx = current_worker();
+		if (idx >= queues.size())
+		{
+			idx = next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queues[idx]->mutex);
+			queues[idx]->tasks.push_back(std::move(task));
+		}
+
+		pending.fetch_add(1);
+
+		// A worker going to sleep either sees the task or is counted here, see worker_loop
+		if (sleeping.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(idle_mutex);
+			}
+			idle_cv.notify_one();
+		}
+	}
+
+	bool pop_own(size_t idx, task_t& task)
+	{
+		worker_queue& queue = *queues[idx];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.tasks.empty()) return false;
+
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(size_t idx, task_t& task)
+	{
+		for (size_t offset = 1; offset < queues.size(); offset++)
+		{
+			worker_queue& queue = *queues[(idx + offset) % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void worker_loop(size_t idx)
+	{
+		current_worker() = idx;
+
+		task_t task;
+		while (true)
+		{
+			if (pop_own(idx, task) || steal(idx, task))
+			{
+				pending.fetch_sub(1);
+
+				task();
+				task = nullptr;
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(idle_mutex);
+
+			sleeping.fetch_add(1);
+			idle_cv.wait(lock, [this]() { return stopping || pending.load() > 0; });
+			sleeping.fetch_sub(1);
+
+			// Queued tasks still run after the pool is stopped
+			if (stopping && pending.load() == 0) return;
+		}
+	}
+
+	std::vector<std::unique_ptr<worker_queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> next_queue = 0;
+
+	// Tasks in the queues, and workers waiting for one
+	std::atomic<size_t> pending = 0;
+	std::atomic<size_t> sleeping = 0;
+
+	std::mutex idle_mutex;
+	std::condition_variable idle_cv;
+	bool stopping = false;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+// Monotonic arena for objects that only live for one tick.
+//
+// Allocations are bump-pointer carved out of a buffer reserved up front, deallocation is a no-op
+// and reset() releases everything at once. A tick that outgrows the buffer falls back to the heap;
+// the next reset() grows the buffer to that tick's peak, so steady-state ticks never reach malloc.
+// Containers opt in through std::pmr allocators. Not thread-safe, use one arena per solver.
+class tick_arena : public std::pmr::memory_resource
+{
+public:
+
+	explicit tick_arena(size_t initial_size = 64 * 1024)
+		: buffer(initial_size)
+	{
+		arena.emplace(buffer.data(), buffer.size(), std::pmr::new_delete_resource());
+	}
+
+	tick_arena(const tick_arena&) = delete;
+	tick_arena& operator=(const tick_arena&) = delete;
+
+	// Frees everything allocated since the last reset. Nothing allocated from the arena may be used afterwards.
+	void reset()
+	{
+		if (num_bytes > buffer.size())
+		{
+			arena.reset();
+			buffer = std::vector<std::byte>(num_bytes * 2);
+		}
+
+		arena.emplace(buffer.data(), buffer.size(), std::pmr::new_delete_resource());
+
+		num_allocations = 0;
+		num_bytes = 0;
+		num_upstream_allocations = 0;
+	}
+
+	size_t capacity() const
+	{
+		return buffer.size();
+	}
+
+	//---- COUNTERS SINCE THE LAST RESET ----//
+
+	uint64_t allocations() const
+	{
+		return num_allocations;
+	}
+
+	// Including alignment slack
+	uint64_t bytes() const
+	{
+		return num_bytes;
+	}
+
+	// Allocations past the end of the buffer, served from chunks taken from the heap
+	uint64_t upstream_allocations() const
+	{
+		return num_upstream_allocations;
+	}
+
+protected:
+
+	void* do_allocate(size_t size, size_t alignment) override
+	{
+		num_allocations++;
+		num_bytes += size + alignment;
+
+		if (num_bytes > buffer.size()) num_upstream_allocations++;
+
+		return arena->allocate(size, alignment);
+	}
+
+	void do_deallocate(void*, size_t, size_t) override
+	{
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+	std::vector<std::byte> buffer;
+	std::optional<std::pmr::monotonic_buffer_resource> arena;
+
+	uint64_t num_allocations = 0;
+	uint64_t num_bytes = 0;
+	uint64_t num_upstream_allocations = 0;
+};
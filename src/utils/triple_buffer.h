@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+// Lock-free single producer, single consumer triple buffer.
+//
+// The producer fills write_buffer() and publishes it with one atomic exchange; the consumer picks
+// up the latest published buffer with another and reads it for as long as it likes. Neither side
+// ever waits for the other, and a buffer is never written while it is being read. Publications
+// the consumer did not pick up in time are simply replaced by newer ones.
+template <class T>
+class triple_buffer
+{
+public:
+
+	triple_buffer() = default;
+
+	triple_buffer(const triple_buffer&) = delete;
+	triple_buffer& operator=(const triple_buffer&) = delete;
+
+	//---- PRODUCER ----//
+
+	T& write_buffer()
+	{
+		return buffers[back];
+	}
+
+	// Hands the write buffer over to the consumer and takes the unused one in exchange
+	void publish()
+	{
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	//---- CONSUMER ----//
+
+	// Switches to the latest published buffer, false if nothing was published since the last call
+	bool update()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	const T& read_buffer() const
+	{
+		return buffers[front];
+	}
+
+protected:
+
+	static constexpr uint8_t INDEX = 0x3;
+	static constexpr uint8_t FRESH = 0x4;
+
+	T buffers[3];
+
+	// Index of the buffer in between the two sides, flagged FRESH while it holds an unread publication
+	std::atomic<uint8_t> middle{ 1 };
+
+	uint8_t back = 0;
+	uint8_t front = 2;
+};
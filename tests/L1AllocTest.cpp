@@ -0,0 +1,65 @@
+// Checks that steady-state L1 ticks go through GameDataL1Parser::parse without heap allocations.
+//
+// A local game_world plays the bundled small map with two players of four trains each and serves
+// the L1 of every tick. Allocations are counted by the replacement operator new of alloc_stats,
+// around the parse only: producing the payload allocates on the server side.
+//
+//   L1AllocTest [maps_dir] [warmup_ticks] [ticks]
+#define COUNT_ALLOCATIONS
+
+#include <src/utils/alloc_stats.h>
+#include <src/game/data/l1_parser.h>
+#include <tests/l1_fixture.h>
+
+#include <iostream>
+
+
+int main(int argc, char* argv[])
+{
+	const std::string maps_dir = argc > 1 ? argv[1] : "res/Server/maps";
+	const uint32_t warmup_ticks = argc > 2 ? std::stoul(argv[2]) : 10;
+	const uint32_t ticks = argc > 3 ? std::stoul(argv[3]) : 200;
+
+	try
+	{
+		const server_map map = server_map::load(std::filesystem::path(maps_dir) / "small");
+
+		l1_fixture fixture("alloc-test", map, 2, game_world_config());
+
+		GameDataL1Parser parser;
+
+		uint64_t max_allocations = 0;
+		uint64_t total_allocations = 0;
+
+		for (uint32_t tick = 0; tick < warmup_ticks + ticks; tick++)
+		{
+			const std::string& response = fixture.next_tick();
+
+			const uint64_t before = alloc_stats::allocations();
+			parser.parse(fixture.gamedata, response);
+			const uint64_t allocations = alloc_stats::allocations() - before;
+
+			if (tick < warmup_ticks) continue;
+
+			max_allocations = std::max(max_allocations, allocations);
+			total_allocations += allocations;
+		}
+
+		std::cout << "L1AllocTest: " << ticks << " ticks after " << warmup_ticks << " warmup tick(s), "
+			<< total_allocations << " allocation(s), at most " << max_allocations << " in one tick" << std::endl;
+
+		if (total_allocations != 0)
+		{
+			std::cout << "L1AllocTest: FAILED, steady-state L1 ticks allocate" << std::endl;
+			return 1;
+		}
+	}
+	catch (const std::exception& err)
+	{
+		std::cout << "L1AllocTest: Error! " << err.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "L1AllocTest: OK" << std::endl;
+	return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <src/server/game_world.h>
+#include <src/server/map.h>
+#include <src/game/data.h>
+
+#include <memory>
+#include <vector>
+
+
+// A local game_world playing a map for L1AllocTest and L1IngestBench.
+//
+// Players are logged in as player-<N> and the state of the first L1 is read with readJSON_L1, the
+// callers parse the later ones. Every tick the stopped trains turn around, so every tick moves every
+// train, and all players end their turn.
+struct l1_fixture
+{
+	boost::asio::io_service io;
+	std::shared_ptr<game_world> world;
+
+	std::vector<Types::player_uid_t> players;
+	GameData gamedata;
+
+	// The L1 of the last tick
+	std::string response;
+
+	l1_fixture(const std::string& game, const server_map& map, uint8_t num_players, const game_world_config& config)
+		: world(std::make_shared<game_world>(io, game, map, num_players, -1, config)), players(num_players)
+	{
+		for (uint8_t idx = 0; idx < num_players; idx++)
+		{
+			if (world->login({ "player-" + std::to_string(idx) }, players[idx], response) != server_connector::Result::OKEY)
+			{
+				throw std::runtime_error("Login failed: " + response);
+			}
+		}
+
+		GameData::readJSON_L0(gamedata, json::parse(map.layer0));
+
+		world->map_layer(1, response);
+		GameData::readJSON_L1(gamedata, json::parse(response));
+	}
+
+	// Plays one tick, response holds its L1
+	const std::string& next_tick()
+	{
+		for (const Types::player_uid_t& player_idx : players)
+		{
+			bounce_trains(player_idx);
+			world->turn(player_idx, [](server_connector::Result, const std::string&) {});
+		}
+
+		world->map_layer(1, response);
+		return response;
+	}
+
+protected:
+
+	// Stopped trains turn around
+	void bounce_trains(const Types::player_uid_t& player_idx)
+	{
+		const Types::player_id_t player_id = gamedata.players.find(player_idx);
+
+		gamedata.trains.for_each_owned(player_id, [&](const Trains::Train& train) {
+			if (train.speed != 0) return;
+
+			const Types::edge_length_t length = gamedata.map_graph->get_edge(train.line_idx).length;
+
+			std::string move_response;
+			world->move(player_idx, { train.line_idx, (int8_t)(train.position < length ? 1 : -1), train.idx }, move_response);
+			});
+	}
+};